@@ -0,0 +1,183 @@
+//  CScreen benchmarks, built against main.cpp the same way Progtest builds it:
+//  g++ -std=c++17 -O2 -pthread bench.cpp -o bench && ./bench [max shapes] [queries]
+//  every scene (uniform, clustered, overlapping) of mixed rectangles, circles, triangles and polygons is indexed
+//  at 10^3 .. max shapes with both layouts and queried by single points, by testMany and by marquee rectangles
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <set>
+#include <map>
+#include <list>
+#include <utility>
+#include <vector>
+#include <memory>
+#include <numeric>
+#include <array>
+#include <climits>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define CSCREEN_SIMD
+#endif
+#define CSCREEN_THREADS
+#define CSCREEN_CLOCK
+
+using namespace std;
+
+//  Progtest supplies CCoord
+struct CCoord {
+public:
+    explicit CCoord(int x = 0, int y = 0) : m_X(x), m_Y(y) {}
+    int m_X, m_Y;
+};
+
+#define __PROGTEST__
+#include "main.cpp"
+
+//  resident memory of the process in bytes, the difference around optimize is the screen size
+static size_t residentBytes() {
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static const int WORLD = 1000000;
+
+//  a shape of the kind id % 4 around the point, size is about its radius
+static unique_ptr<CShape> shapeAt(int id, int x, int y, int size, mt19937 &rng) {
+    switch (id % 4) {
+        case 0: return make_unique<CRectangle>(id, x - size, y - size / 2, x + size, y + size / 2);
+        case 1: return make_unique<CCircle>(id, x, y, size);
+        case 2: return make_unique<CTriangle>(id, CCoord(x - size, y - size), CCoord(x + size, y - size / 3),
+                                              CCoord(x, y + size));
+        default: {
+            //  a convex polygon with 5 .. 32 vertices on a circle
+            vector<CCoord> coords;
+            int vertices = 5 + (int) (rng() % 28);
+            for (int i = 0; i < vertices; i++) {
+                double angle = 2 * M_PI * i / vertices;
+                coords.emplace_back(x + (int) lround(size * cos(angle)), y + (int) lround(size * sin(angle)));
+            }
+            return make_unique<CPolygon>(id, coords.begin(), coords.end());
+        }
+    }
+}
+
+//  small shapes spread over the whole world
+static vector<unique_ptr<CShape>> uniformScene(size_t count, mt19937 &rng) {
+    vector<unique_ptr<CShape>> res;
+    for (size_t i = 0; i < count; i++)
+        res.push_back(shapeAt((int) i, (int) (rng() % WORLD), (int) (rng() % WORLD), 20 + (int) (rng() % 200), rng));
+    return res;
+}
+
+//  most shapes packed into a few dense spots, the rest uniform
+static vector<unique_ptr<CShape>> clusteredScene(size_t count, mt19937 &rng) {
+    vector<pair<int, int>> centres;
+    for (int i = 0; i < 16; i++) centres.emplace_back(rng() % WORLD, rng() % WORLD);
+    normal_distribution<double> spread(0, 3000);
+    vector<unique_ptr<CShape>> res;
+    for (size_t i = 0; i < count; i++) {
+        int x = (int) (rng() % WORLD), y = (int) (rng() % WORLD);
+        if (i % 10) {
+            auto [cx, cy] = centres[rng() % centres.size()];
+            x = cx + (int) spread(rng);
+            y = cy + (int) spread(rng);
+        }
+        res.push_back(shapeAt((int) i, x, y, 10 + (int) (rng() % 100), rng));
+    }
+    return res;
+}
+
+//  shapes of 50 .. 50000 in size, most points lie in dozens of them
+static vector<unique_ptr<CShape>> overlappingScene(size_t count, mt19937 &rng) {
+    vector<unique_ptr<CShape>> res;
+    for (size_t i = 0; i < count; i++) {
+        int size = (int) (50 * pow(10.0, (double) (rng() % 3000) / 1000));
+        res.push_back(shapeAt((int) i, (int) (rng() % WORLD), (int) (rng() % WORLD), size, rng));
+    }
+    return res;
+}
+
+static double percentile(vector<double> &sorted, double p) {
+    return sorted.empty() ? 0 : sorted[min(sorted.size() - 1, (size_t) (p * (double) sorted.size()))];
+}
+
+static void measure(const string &scene, CScreenLayout layout, const vector<unique_ptr<CShape>> &shapes,
+                    size_t queries, mt19937 &rng) {
+    size_t before = residentBytes();
+    CScreen screen(layout);
+    for (const auto &shape: shapes) screen.add(*shape);
+    screen.optimize();
+    size_t memory = residentBytes() - min(before, residentBytes());
+
+    vector<CCoord> points;
+    for (size_t i = 0; i < queries; i++) points.emplace_back(rng() % WORLD, rng() % WORLD);
+    screen.enableStats();
+    vector<double> latency;
+    for (const CCoord &point: points) {
+        auto start = chrono::steady_clock::now();
+        vector<int> ids = screen.test(point.m_X, point.m_Y);
+        latency.push_back(secondsSince(start) * 1e6);
+    }
+    sort(latency.begin(), latency.end());
+    CScreenStats st = screen.stats();
+
+    auto start = chrono::steady_clock::now();
+    CScreenHits hits = screen.testMany(points);
+    double many = (double) points.size() / secondsSince(start) / 1e6;
+    assert (hits.ids.size() == st.hits);
+
+    start = chrono::steady_clock::now();
+    size_t selected = 0;
+    for (size_t i = 0; i < 100; i++) {
+        int x = (int) (rng() % WORLD), y = (int) (rng() % WORLD), side = 1000 + (int) (rng() % 20000);
+        selected += screen.testRect(x, y, x + side, y + side).size();
+    }
+    double marquee = secondsSince(start) * 1e6 / 100;
+
+    double q = (double) max<size_t>(st.queries, 1);
+    cout << setw(12) << scene << setw(7) << (layout == CScreenLayout::GRID ? "grid" : "rtree") << setw(9) << shapes.size()
+         << setw(10) << fixed << setprecision(3) << st.optimizeSeconds
+         << setw(9) << setprecision(2) << percentile(latency, 0.5) << setw(9) << percentile(latency, 0.99)
+         << setw(9) << percentile(latency, 0.999) << setw(9) << (double) memory / (1 << 20)
+         << setw(9) << setprecision(1) << (double) st.candidates / q << setw(9) << (double) st.exactTests / q
+         << setw(8) << setprecision(2) << (double) st.hits / q << setw(9) << many
+         << setw(11) << setprecision(1) << marquee << setw(9) << selected / 100 << endl;
+}
+
+int main(int argc, char *argv[]) {
+    size_t maxShapes = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+    size_t queries = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100000;
+
+    mt19937 rng(1);
+    cout << setw(12) << "scene" << setw(7) << "index" << setw(9) << "shapes" << setw(10) << "build s"
+         << setw(9) << "p50 us" << setw(9) << "p99 us" << setw(9) << "p999 us" << setw(9) << "mem MB"
+         << setw(9) << "cand/q" << setw(9) << "exact/q" << setw(8) << "hits/q" << setw(9) << "many M/s"
+         << setw(11) << "marquee us" << setw(9) << "sel/rect" << endl;
+    for (size_t count = 1000; count <= max<size_t>(maxShapes, 1000); count *= 10)
+        for (auto scene: {uniformScene, clusteredScene, overlappingScene}) {
+            vector<unique_ptr<CShape>> shapes = scene(count, rng);
+            string name = scene == uniformScene ? "uniform" : scene == clusteredScene ? "clustered" : "overlapping";
+            for (CScreenLayout layout: {CScreenLayout::GRID, CScreenLayout::RTREE}) measure(name, layout, shapes, queries, rng);
+        }
+    return EXIT_SUCCESS;
+}
@@ -2,6 +2,7 @@
 
 #include <cmath>
 #include <cstdlib>
+#include <cstdint>
 #include <cstdio>
 #include <cassert>
 #include <iostream>
@@ -13,6 +14,21 @@
 #include <utility>
 #include <vector>
 #include <memory>
+#include <numeric>
+#include <array>
+#include <climits>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define CSCREEN_SIMD
+#endif
+
+//  parts the Progtest harness cannot build, its include set has none of these headers
+#define CSCREEN_THREADS // <thread>, <atomic>
+#define CSCREEN_CLOCK   // <chrono>
 
 using namespace std;
 
@@ -25,13 +41,26 @@ public:
 
 #endif /* __PROGTEST__ */
 
+//  range of int coordinates, <climits> is not in the Progtest include set
+constexpr long COORD_MIN = -2147483647L - 1, COORD_MAX = 2147483647L;
+
+//  exact cross products: a coordinate difference takes 33 bits, a product of two of them overflows long
+__extension__ typedef __int128 CWide;
+
+//  axis-aligned bounding box, bounds included
+struct CBox {
+    long x1, y1, x2, y2;
+    [[nodiscard]] bool contains(long x, long y) const { return x >= x1 && x <= x2 && y >= y1 && y <= y2; }
+};
+
 class CShape {
 public:
     explicit CShape(const int id, const char type) : m_Id(id), m_Type(type) {}
     virtual ~CShape() = default;
     [[nodiscard]] virtual bool hasPoint(const CCoord & point) const = 0;
+    [[nodiscard]] virtual CBox box() const = 0;
     [[nodiscard]] virtual unique_ptr<CShape> getPtr() const = 0;
-    friend class CScreen;
+    friend class CScreenState;
 protected:
     int m_Id;
     char m_Type;
@@ -45,9 +74,13 @@ public:
         auto y_min = min(m_y1, m_y2), y_max = max(m_y1, m_y2);
         return (point.m_X >= x_min && point.m_X <= x_max && point.m_Y >= y_min && point.m_Y <= y_max);
     }
+    [[nodiscard]] CBox box() const override {
+        return {min(m_x1, m_x2), min(m_y1, m_y2), max(m_x1, m_x2), max(m_y1, m_y2)};
+    }
     [[nodiscard]] unique_ptr<CShape> getPtr() const override {
         return make_unique<CRectangle>(*this);
     }
+    friend class CScreenState;
 private:
     int m_x1, m_y1, m_x2, m_y2;
 };
@@ -56,11 +89,21 @@ class CCircle : public CShape {
 public:
     CCircle (const int id, const int x, const int y, const int r) : CShape(id, 'c'), m_x(x), m_y(y), m_r(r) {}
     [[nodiscard]] bool hasPoint(const CCoord & point) const override {
-        return pow(point.m_X - m_x, 2) + pow(point.m_Y - m_y, 2) <= pow(m_r, 2);
+        return contains(m_x, m_y, m_r, point.m_X, point.m_Y);
+    }
+    //  exact in integers: both distances are at most r, so their squares add up within 64 bits
+    static bool contains(long cx, long cy, long r, long x, long y) {
+        auto dx = (unsigned long long) labs(x - cx), dy = (unsigned long long) labs(y - cy);
+        auto radius = (unsigned long long) labs(r);
+        return dx <= radius && dy <= radius && dx * dx + dy * dy <= radius * radius;
+    }
+    [[nodiscard]] CBox box() const override {
+        return {(long) m_x - m_r, (long) m_y - m_r, (long) m_x + m_r, (long) m_y + m_r};
     }
     [[nodiscard]] unique_ptr<CShape> getPtr() const override {
         return make_unique<CCircle>(*this);
     }
+    friend class CScreenState;
 private:
     int m_x, m_y, m_r;
 };
@@ -69,80 +112,1350 @@ class CTriangle : public CShape {
 public:
     CTriangle (const int id, const CCoord & a, const CCoord & b, const CCoord & c) : CShape(id, 't'), xa(a.m_X), xb(b.m_X), xc(c.m_X), ya(a.m_Y), yb(b.m_Y), yc(c.m_Y) {}
     [[nodiscard]] bool hasPoint(const CCoord & point) const override {
-        long px = point.m_X, py = point.m_Y;
-        long side1 = ((xa-px)*(yb-ya)-(ya-py)*(xb-xa));
-        long side2 = ((xb-px)*(yc-yb)-(yb-py)*(xc-xb));
-        long side3 = ((xc-px)*(ya-yc)-(yc-py)*(xa-xc));
-        return ((side1 == side2 && side1 == side3 && side1 == 0)
-        || (side1 > 0 && side2 > 0 && side3 > 0)
-        || (side1 < 0 && side2 < 0 && side3 < 0));
+        return contains(xa, ya, xb, yb, xc, yc, point.m_X, point.m_Y);
+    }
+    static bool contains(long xa, long ya, long xb, long yb, long xc, long yc, long px, long py) {
+        CWide side1 = (CWide) (xa-px)*(yb-ya)-(CWide) (ya-py)*(xb-xa);
+        CWide side2 = (CWide) (xb-px)*(yc-yb)-(CWide) (yb-py)*(xc-xb);
+        CWide side3 = (CWide) (xc-px)*(ya-yc)-(CWide) (yc-py)*(xa-xc);
+        //  a degenerate triangle is a segment, the point has to lie within it
+        if (side1 == 0 && side2 == 0 && side3 == 0)
+            return min({xa, xb, xc}) <= px && px <= max({xa, xb, xc}) && min({ya, yb, yc}) <= py && py <= max({ya, yb, yc});
+        //  points on the edges are inside
+        return ((side1 >= 0 && side2 >= 0 && side3 >= 0)
+        || (side1 <= 0 && side2 <= 0 && side3 <= 0));
+    }
+    [[nodiscard]] CBox box() const override {
+        return {min({xa, xb, xc}), min({ya, yb, yc}), max({xa, xb, xc}), max({ya, yb, yc})};
     }
     [[nodiscard]] unique_ptr<CShape> getPtr() const override {
         return make_unique<CTriangle>(*this);
     }
+    friend class CScreenState;
 private:
         long xa, xb, xc, ya, yb, yc;
 };
 
 class CPolygon : public CShape {
 public:
-    CPolygon (const int id, const CCoord * b, const CCoord * e) : CShape(id, 'p'), coords(b, e) {}
+    CPolygon (const int id, const CCoord * b, const CCoord * e) : CShape(id, 'p'), coords(b, e) { canonicalize(coords); }
 
     template<typename Iter>
-    CPolygon (const int id, const Iter b, const Iter e) : CShape(id, 'p') { coords.assign(b, e); }
+    CPolygon (const int id, const Iter b, const Iter e) : CShape(id, 'p') { coords.assign(b, e); canonicalize(coords); }
 
-    CPolygon(const int id, const initializer_list<CCoord> &coordList) : CShape(id, 'p'), coords{coordList} {}
+    CPolygon(const int id, const initializer_list<CCoord> &coordList) : CShape(id, 'p'), coords{coordList} { canonicalize(coords); }
 
     template<typename Head, typename... Tail>
-    CPolygon(const int id, const Head h, const Tail... tail) : CShape(id, 'p'), coords{tail...} { coords.push_back(h); }
+    CPolygon(const int id, const Head h, const Tail... tail) : CShape(id, 'p'), coords{tail...} {
+        coords.push_back(h);
+        canonicalize(coords);
+    }
 
     [[nodiscard]] unique_ptr<CShape> getPtr() const override {
         return make_unique<CPolygon>(*this);
     }
 
     [[nodiscard]] bool hasPoint(const CCoord &point) const override {
-        long numVertPoints = (long) coords.size();
-        if (numVertPoints == 3) return CTriangle(this->m_Id, coords[0], coords[1], coords[2]).hasPoint(point);
-
+        return contains(coords.data(), coords.size(), point);
+    }
+    //  coords in canonical order, see canonicalize: the fan of triangles from the first vertex is binary searched
+    //  for the one around the point, which decides it with CTriangle::contains, so the edges are inside too
+    static bool contains(const CCoord *coords, size_t size, const CCoord &point) {
         long px = point.m_X, py = point.m_Y;
-        long j = numVertPoints - 1;
-        bool res = false;
-        for (long i = 0; i < numVertPoints; i++) {
-            long xi = coords[i].m_X, xj = coords[j].m_X, yi = coords[i].m_Y, yj = coords[j].m_Y;
-            if ((yi > py) == (yj > py)) {
-                j = i;
-                continue;
-            }
-            auto cross = (xj - xi) * (py - yi) / (yj - yi) + xi;
-            if (px < cross) res = !res;
-            j = i;
+        if (size < 3) {
+            if (size == 0) return false;
+            const CCoord &a = coords[0], &b = coords[size - 1];
+            return CTriangle::contains(a.m_X, a.m_Y, b.m_X, b.m_Y, b.m_X, b.m_Y, px, py);
+        }
+        const CCoord &first = coords[0];
+        auto side = [&](const CCoord &c) { return cross(first, c, px, py); };
+        if (side(coords[1]) < 0 || side(coords[size - 1]) > 0) return false;
+        //  coords[lo] is left of the point or in line with it, coords[hi] right of it or the last vertex
+        size_t lo = 1, hi = size - 1;
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (side(coords[mid]) >= 0) lo = mid;
+            else hi = mid;
+        }
+        return CTriangle::contains(first.m_X, first.m_Y, coords[lo].m_X, coords[lo].m_Y, coords[lo + 1].m_X,
+                                   coords[lo + 1].m_Y, px, py);
+    }
+
+    //  orders a convex polygon counter-clockwise from its lowest (then leftmost) vertex and drops repeated and
+    //  collinear vertices; a polygon with no area keeps the two ends of its segment
+    static void canonicalize(vector<CCoord> &coords) {
+        auto same = [](const CCoord &a, const CCoord &b) { return a.m_X == b.m_X && a.m_Y == b.m_Y; };
+        auto lower = [](const CCoord &a, const CCoord &b) { return make_pair(a.m_Y, a.m_X) < make_pair(b.m_Y, b.m_X); };
+        CWide area = 0;
+        for (size_t i = 0; i < coords.size(); i++) {
+            const CCoord &a = coords[i], &b = coords[(i + 1) % coords.size()];
+            area += (CWide) a.m_X * b.m_Y - (CWide) b.m_X * a.m_Y;
+        }
+        if (area == 0) {
+            if (coords.empty()) return;
+            auto [low, high] = minmax_element(coords.begin(), coords.end(), lower);
+            vector<CCoord> ends{*low};
+            if (!same(*low, *high)) ends.push_back(*high);
+            coords.swap(ends);
+            return;
+        }
+        if (area < 0) reverse(coords.begin(), coords.end());
+
+        vector<CCoord> res;
+        for (const CCoord &c: coords) {
+            if (!res.empty() && same(res.back(), c)) continue;
+            while (res.size() >= 2 && cross(res[res.size() - 2], res.back(), c.m_X, c.m_Y) == 0) res.pop_back();
+            res.push_back(c);
         }
+        //  the same around the seam
+        size_t from = 0;
+        while (res.size() - from >= 3) {
+            if (same(res.back(), res[from]) || cross(res[res.size() - 2], res.back(), res[from].m_X, res[from].m_Y) == 0)
+                res.pop_back();
+            else if (cross(res.back(), res[from], res[from + 1].m_X, res[from + 1].m_Y) == 0) from++;
+            else break;
+        }
+        res.erase(res.begin(), res.begin() + (long) from);
+        rotate(res.begin(), min_element(res.begin(), res.end(), lower), res.end());
+        coords.swap(res);
+    }
+
+    //  > 0 when the point is left of the direction from a to b
+    static CWide cross(const CCoord &a, const CCoord &b, long px, long py) {
+        return (CWide) ((long) b.m_X - a.m_X) * (py - a.m_Y) - (CWide) ((long) b.m_Y - a.m_Y) * (px - a.m_X);
+    }
+
+    //  a polygon without vertices contains no point, its box is the origin
+    [[nodiscard]] CBox box() const override {
+        if (coords.empty()) return {0, 0, 0, 0};
+        CBox res{coords[0].m_X, coords[0].m_Y, coords[0].m_X, coords[0].m_Y};
+        for (const auto &c: coords) res = {min(res.x1, (long) c.m_X), min(res.y1, (long) c.m_Y),
+                                           max(res.x2, (long) c.m_X), max(res.y2, (long) c.m_Y)};
         return res;
     }
+    friend class CScreenState;
 private:
     vector<CCoord> coords;
 };
 
-class CScreen {
+//  results of CScreen::testMany, the IDs hit by query i are ids[offsets[i] .. offsets[i + 1]), sorted
+struct CScreenHits {
+    vector<size_t> offsets;
+    vector<int> ids;
+};
+
+//  what CScreen queries did since stats were enabled; per query averages are candidates / queries etc.
+struct CScreenStats {
+    double optimizeSeconds = 0; // the last optimize, counted always
+    size_t queries = 0;         // points of test and testMany, rectangles of testRect
+    size_t candidates = 0;      // shapes the index handed to the tests
+    size_t exactTests = 0;      // candidates beyond a box check: circles, triangles and polygons whose box held the query
+    size_t hits = 0;            // IDs reported
+};
+
+//  value that any number of reading threads update at once, a relaxed atomic with CSCREEN_THREADS, plain without
+template<typename T_>
+class CRelaxed {
 public:
-    CScreen() = default;
+    CRelaxed(T_ value = T_()) : value(value) {}
+#ifdef CSCREEN_THREADS
+    T_ get() const { return value.load(memory_order_relaxed); }
+    void set(T_ v) { value.store(v, memory_order_relaxed); }
+    void add(T_ n) { value.fetch_add(n, memory_order_relaxed); }
+private:
+    atomic<T_> value;
+#else
+    T_ get() const { return value; }
+    void set(T_ v) { value = v; }
+    void add(T_ n) { value += n; }
+private:
+    T_ value;
+#endif
+};
 
-    void add(const CShape & shape) {
-        shapes.emplace_back(shape.getPtr());
+//  live counters behind CScreenStats, updated by any number of reading threads
+struct CScreenCounters {
+    void record(size_t found) {
+        queries.add(1);
+        hits.add(found);
     }
 
+    CRelaxed<bool> enabled{false};
+    CRelaxed<double> optimizeSeconds{0};
+    CRelaxed<size_t> queries, candidates, exactTests, hits;
+};
+
+//  measures optimize, always 0 without CSCREEN_CLOCK
+class CStopwatch {
+public:
+#ifdef CSCREEN_CLOCK
+    double seconds() const { return chrono::duration<double>(chrono::steady_clock::now() - start).count(); }
+private:
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+#else
+    double seconds() const { return 0; }
+#endif
+};
+
+//  raster CScreen::optimize builds over a region queried often, e.g. the viewport; a tile remembers the shapes
+//  containing all of it and the ones crossing it, so a query in a tile without crossing shapes tests no geometry
+struct CScreenRaster {
+    CBox region{0, 0, -1, -1};  // none by default
+    long tile = 8;              // side of a tile, doubled until the raster fits into the budget
+    size_t budget = 64 << 20;   // bytes
+};
+
+//  spatial index CScreen::optimize builds
+enum class CScreenLayout {
+    GRID,   // uniform grid, best for shapes of similar size spread over the scene
+    RTREE   // Sort-Tile-Recursive R-tree, for scenes mixing huge and tiny shapes
+};
+
+//  one version of a screen: the shapes optimize indexed, shared with the other versions and never changed, and
+//  the ones added or moved since, which are its own; CScreen reads one version while it edits another. Between
+//  two rebuilds of the whole index, optimize gathers the changes into a small recent index of their own, so the
+//  delta tested one by one stays below DELTA_MAX shapes
+class CScreenState {
+public:
+    explicit CScreenState(CScreenLayout layout = CScreenLayout::GRID, const CScreenRaster &raster = {})
+            : layout(layout), raster(raster) {}
+
+    //  copies the shape into the plain arrays of its kind in the delta
+    void add(const CShape & shape) { delta.add(shape); }
+
+    //  removes every shape with the ID, a slot of the delta is only marked as removed and the ID hides the shapes
+    //  of the indexes until they are rebuilt; false if there is none
+    bool remove(int id) {
+        vector<CRef> found = delta.find(id), indexed = indexedFind(index.get(), hidden, id),
+                inRecent = indexedFind(recent.get(), recentHidden, id);
+        for (CRef ref: found) delta.kill(ref);
+        if (!indexed.empty()) hide(hidden, id);
+        if (!inRecent.empty()) hide(recentHidden, id);
+        return !found.empty() || !indexed.empty() || !inRecent.empty();
+    }
+
+    //  moves every shape with the ID, a shape of an index is hidden and its moved copy goes to the delta;
+    //  false if there is none or if one of them would leave the int range, nothing is moved then
+    bool move(int id, int dx, int dy) {
+        vector<CRef> found = delta.find(id), indexed = indexedFind(index.get(), hidden, id),
+                inRecent = indexedFind(recent.get(), recentHidden, id);
+        auto fit = [dx, dy](const CShapes &shapes, const vector<CRef> &refs) {
+            return all_of(refs.begin(), refs.end(), [&](CRef ref) { return shapes.fits(ref, dx, dy); });
+        };
+        if (!fit(delta, found) || (index && !fit(index->shapes, indexed)) || (recent && !fit(recent->shapes, inRecent)))
+            return false;
+        for (CRef ref: indexed) found.push_back(delta.append(index->shapes, ref));
+        for (CRef ref: inRecent) found.push_back(delta.append(recent->shapes, ref));
+        if (!indexed.empty()) hide(hidden, id);
+        if (!inRecent.empty()) hide(recentHidden, id);
+        for (CRef ref: found) delta.shift(ref, dx, dy);
+        return !found.empty();
+    }
+
+    //  IDs of the shapes containing the point in ascending order; shapes added or moved since the last
+    //  optimize are tested one by one
     [[nodiscard]] vector<int> test(int x, int y) const {
         vector<int> ids;
-        for (const auto &shape: shapes) {
-            if (shape->hasPoint(CCoord(x, y)))
-                ids.emplace_back(shape->m_Id);
+        collect(x, y, ids);
+        return ids;
+    }
+
+    //  IDs of the shapes sharing a point with the rectangle, or with contained only of the ones lying inside it,
+    //  in ascending order; only the cells or nodes the rectangle overlaps are visited
+    [[nodiscard]] vector<int> testRect(int x1, int y1, int x2, int y2, bool contained = false) const {
+        CBox area{min(x1, x2), min(y1, y2), max(x1, x2), max(y1, y2)};
+        vector<int> ids;
+        auto visit = [&](const CShapes &shapes, CRef ref) {
+            if (meets(shapes, ref, area, contained)) ids.push_back(shapes.idOf(ref >> KIND_SHIFT, ref & SLOT_MASK));
+        };
+        if (index) {
+            visitIndexed(*index, area, [&](CRef ref) { visit(index->shapes, ref); });
+            dropHidden(ids, 0, hidden);
+        }
+        if (recent) {
+            size_t at = ids.size();
+            visitIndexed(*recent, area, [&](CRef ref) { visit(recent->shapes, ref); });
+            dropHidden(ids, at, recentHidden);
         }
+        for (unsigned kind = 0; kind < KINDS; kind++)
+            for (size_t slot = 0; slot < delta.count(kind); slot++) visit(delta, kind << KIND_SHIFT | (CRef) slot);
+        sort(ids.begin(), ids.end());
+        if (counters->enabled.get()) counters->record(ids.size());
         return ids;
     }
 
-    void optimize() {}
+    //  the counters CScreen::stats reads, shared by every copy of the state
+    [[nodiscard]] CScreenCounters &statistics() const { return *counters; }
+
+    //  tests all points at once, threads = 0 uses every core; queries are processed in Morton order so that
+    //  neighbouring points reuse the same cells and nodes, in chunks the threads take from their own range
+    //  and steal from the others when it runs out
+    [[nodiscard]] CScreenHits testMany(const vector<CCoord> &points, unsigned threads = 0) const {
+        vector<pair<uint64_t, size_t>> order(points.size());
+        for (size_t i = 0; i < points.size(); i++) order[i] = {morton(points[i]), i};
+        sort(order.begin(), order.end());
+
+        size_t chunks = (order.size() + CHUNK - 1) / CHUNK;
+#ifdef CSCREEN_THREADS
+        if (!threads) threads = max(1u, thread::hardware_concurrency());
+        threads = (unsigned) max<size_t>(1, min<size_t>(threads, chunks));
+#else
+        threads = 1;
+#endif
+        //  the chunk of query order[i] stores its hits at hits[chunk][from[i] .. from[i] + counts[i])
+        vector<vector<int>> hits(chunks);
+        vector<size_t> from(order.size()), counts(order.size());
+        auto run = [&](size_t chunk) {
+            vector<int> &buffer = hits[chunk];
+            for (size_t i = chunk * CHUNK; i < min(order.size(), (chunk + 1) * CHUNK); i++) {
+                from[i] = buffer.size();
+                collect(points[order[i].second].m_X, points[order[i].second].m_Y, buffer);
+                counts[i] = buffer.size() - from[i];
+            }
+        };
+        if (threads == 1)
+            for (size_t chunk = 0; chunk < chunks; chunk++) run(chunk);
+#ifdef CSCREEN_THREADS
+        else {
+            //  worker w owns chunks [next[w], ends[w]), anybody claims one by advancing next
+            unique_ptr<atomic<size_t>[]> next(new atomic<size_t>[threads]);
+            vector<size_t> ends(threads);
+            for (unsigned w = 0; w < threads; w++) {
+                next[w] = chunks * w / threads;
+                ends[w] = chunks * (w + 1) / threads;
+            }
+            auto worker = [&](unsigned self) {
+                for (unsigned k = 0; k < threads; k++) {
+                    unsigned victim = (self + k) % threads;
+                    for (size_t chunk; (chunk = next[victim]++) < ends[victim];) run(chunk);
+                }
+            };
+            vector<thread> pool;
+            for (unsigned w = 1; w < threads; w++) pool.emplace_back(worker, w);
+            worker(0);
+            for (auto &t: pool) t.join();
+        }
+#endif
+
+        CScreenHits res;
+        res.offsets.assign(points.size() + 1, 0);
+        for (size_t i = 0; i < order.size(); i++) res.offsets[order[i].second + 1] = counts[i];
+        for (size_t i = 1; i < res.offsets.size(); i++) res.offsets[i] += res.offsets[i - 1];
+        res.ids.resize(res.offsets.back());
+        for (size_t i = 0; i < order.size(); i++) {
+            const int *src = hits[i / CHUNK].data() + from[i];
+            copy(src, src + counts[i], res.ids.begin() + (long) res.offsets[order[i].second]);
+        }
+        return res;
+    }
+
+    //  builds the index of the layout chosen at construction and the raster over it; an index with few changes
+    //  since it was built is kept together with its raster, and a delta of more than DELTA_MAX shapes goes to the
+    //  recent index instead; true if anything changed
+    bool optimize() {
+        size_t changes = delta.total() + hidden.size() + (recent ? recent->shapes.total() : 0);
+        if (!index || changes > max(MERGE_MIN, index->shapes.total() / 16)) {
+            index = rebuild(true);
+            recent.reset();
+            hidden.clear();
+        } else if (delta.total() > DELTA_MAX) recent = rebuild(false);
+        else return false;
+        delta = CShapes();
+        recentHidden.clear();
+        return true;
+    }
 private:
-    vector <unique_ptr<CShape>> shapes;
+    //  a reference to a shape packs its kind into the top bits and its slot in the arrays of that kind below
+    using CRef = unsigned;
+    enum EKind : unsigned { RECTANGLE, CIRCLE, TRIANGLE, POLYGON, KINDS };
+    static constexpr unsigned KIND_SHIFT = 30;
+    static constexpr CRef SLOT_MASK = (1u << KIND_SHIFT) - 1;
+
+    //  shapes spanning more cells go to an R-tree of their own instead of the grid
+    static constexpr long LARGE_CELLS = 64;
+    //  children of an R-tree node
+    static constexpr size_t NODE = 16;
+    //  queries testMany hands to a thread at once
+    static constexpr size_t CHUNK = 256;
+    //  changes kept beside the index before optimize rebuilds it
+    static constexpr size_t MERGE_MIN = 256;
+    //  shapes optimize leaves in the delta, more go to the recent index
+    static constexpr size_t DELTA_MAX = 64;
+    //  box of a removed slot, contains no point
+    static constexpr CBox NOWHERE{1, 1, 0, 0};
+
+    //  rectangles normalized to x1 <= x2 and y1 <= y2, one array per field; a removed one is empty
+    struct CRectangles {
+        vector<int> x1, y1, x2, y2, id;
+    };
+
+    //  circles with their bounding boxes clamped to int, a removed circle gets an empty box
+    struct CCircles {
+        vector<int> x, y, r, id, x1, y1, x2, y2;
+    };
+
+    struct CTriangleData {
+        long xa, ya, xb, yb, xc, yc;
+        CBox box;
+        int id;
+    };
+
+    struct CPolygonData {
+        size_t first, count;    // vertices[first .. first + count)
+        CBox box;
+        int id;
+    };
+
+    //  shapes in the plain arrays of their kinds, a removed one keeps its slot until the arrays are rebuilt
+    struct CShapes {
+        //  copies the shape to the end of the arrays of its kind
+        void add(const CShape & shape) {
+            switch (shape.m_Type) {
+                case 'r': {
+                    const auto &r = static_cast<const CRectangle &>(shape);
+                    rects.x1.push_back(min(r.m_x1, r.m_x2));
+                    rects.y1.push_back(min(r.m_y1, r.m_y2));
+                    rects.x2.push_back(max(r.m_x1, r.m_x2));
+                    rects.y2.push_back(max(r.m_y1, r.m_y2));
+                    rects.id.push_back(r.m_Id);
+                    break;
+                }
+                case 'c': {
+                    const auto &c = static_cast<const CCircle &>(shape);
+                    circles.x.push_back(c.m_x);
+                    circles.y.push_back(c.m_y);
+                    circles.r.push_back(c.m_r);
+                    circles.id.push_back(c.m_Id);
+                    for (auto *column: {&circles.x1, &circles.y1, &circles.x2, &circles.y2}) column->push_back(0);
+                    circleBox(circles.id.size() - 1);
+                    break;
+                }
+                case 't': {
+                    const auto &t = static_cast<const CTriangle &>(shape);
+                    triangles.push_back({t.xa, t.ya, t.xb, t.yb, t.xc, t.yc, t.box(), t.m_Id});
+                    break;
+                }
+                default: {
+                    const auto &p = static_cast<const CPolygon &>(shape);
+                    polygons.push_back({vertices.size(), p.coords.size(), p.box(), p.m_Id});
+                    vertices.insert(vertices.end(), p.coords.begin(), p.coords.end());
+                }
+            }
+        }
+
+        //  appends a copy of a shape of the other arrays, returns its reference here
+        CRef append(const CShapes &from, CRef ref) {
+            size_t s = ref & SLOT_MASK;
+            switch (ref >> KIND_SHIFT) {
+                case RECTANGLE:
+                    for (auto column: {&CRectangles::x1, &CRectangles::y1, &CRectangles::x2, &CRectangles::y2, &CRectangles::id})
+                        (rects.*column).push_back((from.rects.*column)[s]);
+                    break;
+                case CIRCLE:
+                    for (auto column: {&CCircles::x, &CCircles::y, &CCircles::r, &CCircles::id, &CCircles::x1, &CCircles::y1,
+                                       &CCircles::x2, &CCircles::y2})
+                        (circles.*column).push_back((from.circles.*column)[s]);
+                    break;
+                case TRIANGLE:
+                    triangles.push_back(from.triangles[s]);
+                    break;
+                default: {
+                    const CPolygonData &p = from.polygons[s];
+                    polygons.push_back({vertices.size(), p.count, p.box, p.id});
+                    vertices.insert(vertices.end(), from.vertices.begin() + (long) p.first,
+                                    from.vertices.begin() + (long) (p.first + p.count));
+                }
+            }
+            return (ref & ~SLOT_MASK) | (CRef) (count(ref >> KIND_SHIFT) - 1);
+        }
+
+        //  live shapes with the ID, slot by slot
+        [[nodiscard]] vector<CRef> find(int id) const {
+            vector<CRef> res;
+            for (unsigned kind = 0; kind < KINDS; kind++)
+                for (size_t slot = 0; slot < count(kind); slot++)
+                    if (idOf(kind, slot) == id && !removed(kind << KIND_SHIFT | (CRef) slot))
+                        res.push_back(kind << KIND_SHIFT | (CRef) slot);
+            return res;
+        }
+
+        //  empties the box of the slot, the tests reject it from then on
+        void kill(CRef ref) {
+            size_t s = ref & SLOT_MASK;
+            switch (ref >> KIND_SHIFT) {
+                case RECTANGLE:
+                    rects.x1[s] = rects.y1[s] = (int) NOWHERE.x1;
+                    rects.x2[s] = rects.y2[s] = (int) NOWHERE.x2;
+                    break;
+                case CIRCLE:
+                    circles.x1[s] = circles.y1[s] = (int) NOWHERE.x1;
+                    circles.x2[s] = circles.y2[s] = (int) NOWHERE.x2;
+                    break;
+                case TRIANGLE:
+                    triangles[s].box = NOWHERE;
+                    break;
+                default:
+                    polygons[s].box = NOWHERE;
+            }
+        }
+
+        //  whether the shape moved by dx, dy keeps its coordinates within int, a circle its centre
+        [[nodiscard]] bool fits(CRef ref, int dx, int dy) const {
+            size_t s = ref & SLOT_MASK;
+            CBox box = ref >> KIND_SHIFT == CIRCLE ? CBox{circles.x[s], circles.y[s], circles.x[s], circles.y[s]} : boxOf(ref);
+            return box.x1 + dx >= COORD_MIN && box.x2 + dx <= COORD_MAX && box.y1 + dy >= COORD_MIN && box.y2 + dy <= COORD_MAX;
+        }
+
+        //  moves the shape by dx, dy, which fits has allowed
+        void shift(CRef ref, int dx, int dy) {
+            size_t s = ref & SLOT_MASK;
+            auto sx = [dx](int &x) { x = (int) ((long) x + dx); };
+            auto sy = [dy](int &y) { y = (int) ((long) y + dy); };
+            switch (ref >> KIND_SHIFT) {
+                case RECTANGLE:
+                    sx(rects.x1[s]);
+                    sx(rects.x2[s]);
+                    sy(rects.y1[s]);
+                    sy(rects.y2[s]);
+                    break;
+                case CIRCLE:
+                    sx(circles.x[s]);
+                    sy(circles.y[s]);
+                    circleBox(s);
+                    break;
+                case TRIANGLE: {
+                    CTriangleData &t = triangles[s];
+                    t.xa += dx, t.xb += dx, t.xc += dx;
+                    t.ya += dy, t.yb += dy, t.yc += dy;
+                    t.box = {t.box.x1 + dx, t.box.y1 + dy, t.box.x2 + dx, t.box.y2 + dy};
+                    break;
+                }
+                default: {
+                    CPolygonData &p = polygons[s];
+                    for (size_t v = p.first; v < p.first + p.count; v++)
+                        vertices[v] = CCoord((int) ((long) vertices[v].m_X + dx), (int) ((long) vertices[v].m_Y + dy));
+                    p.box = {p.box.x1 + dx, p.box.y1 + dy, p.box.x2 + dx, p.box.y2 + dy};
+                }
+            }
+        }
+
+        //  bounding box clamped to int, points outside of it are outside of the circle either way
+        void circleBox(size_t s) {
+            long radius = labs((long) circles.r[s]);
+            circles.x1[s] = (int) max(COORD_MIN, circles.x[s] - radius);
+            circles.y1[s] = (int) max(COORD_MIN, circles.y[s] - radius);
+            circles.x2[s] = (int) min(COORD_MAX, circles.x[s] + radius);
+            circles.y2[s] = (int) min(COORD_MAX, circles.y[s] + radius);
+        }
+
+        //  drops the removed slots and renumbers every kind in ID order, which keeps the tests of equal IDs in
+        //  insertion order
+        void sortById() {
+            vector<size_t> order = liveOrder(RECTANGLE);
+            for (auto *column: {&rects.x1, &rects.y1, &rects.x2, &rects.y2, &rects.id}) permute(*column, order);
+            order = liveOrder(CIRCLE);
+            for (auto *column: {&circles.x, &circles.y, &circles.r, &circles.id, &circles.x1, &circles.y1, &circles.x2,
+                                &circles.y2})
+                permute(*column, order);
+            permute(triangles, liveOrder(TRIANGLE));
+            permute(polygons, liveOrder(POLYGON));
+            //  the pool keeps the vertices of the live polygons only, in their new order
+            vector<CCoord> pool;
+            for (CPolygonData &p: polygons) {
+                pool.insert(pool.end(), vertices.begin() + (long) p.first, vertices.begin() + (long) (p.first + p.count));
+                p.first = pool.size() - p.count;
+            }
+            vertices.swap(pool);
+        }
+
+        //  slots of the kind that were not removed, stable in ID order
+        [[nodiscard]] vector<size_t> liveOrder(unsigned kind) const {
+            vector<size_t> order;
+            for (size_t slot = 0; slot < count(kind); slot++)
+                if (!removed(kind << KIND_SHIFT | (CRef) slot)) order.push_back(slot);
+            stable_sort(order.begin(), order.end(), [this, kind](size_t a, size_t b) { return idOf(kind, a) < idOf(kind, b); });
+            return order;
+        }
+
+        //  keeps column[order[0]], column[order[1]], ...
+        template<typename T_>
+        static void permute(vector<T_> &column, const vector<size_t> &order) {
+            vector<T_> res(order.size());
+            for (size_t i = 0; i < order.size(); i++) res[i] = std::move(column[order[i]]);
+            column.swap(res);
+        }
+
+        [[nodiscard]] size_t count(unsigned kind) const {
+            switch (kind) {
+                case RECTANGLE: return rects.id.size();
+                case CIRCLE: return circles.id.size();
+                case TRIANGLE: return triangles.size();
+                default: return polygons.size();
+            }
+        }
+
+        [[nodiscard]] size_t total() const { return count(RECTANGLE) + count(CIRCLE) + count(TRIANGLE) + count(POLYGON); }
+
+        [[nodiscard]] int idOf(unsigned kind, size_t slot) const {
+            switch (kind) {
+                case RECTANGLE: return rects.id[slot];
+                case CIRCLE: return circles.id[slot];
+                case TRIANGLE: return triangles[slot].id;
+                default: return polygons[slot].id;
+            }
+        }
+
+        [[nodiscard]] CBox boxOf(CRef ref) const {
+            size_t s = ref & SLOT_MASK;
+            switch (ref >> KIND_SHIFT) {
+                case RECTANGLE: return {rects.x1[s], rects.y1[s], rects.x2[s], rects.y2[s]};
+                case CIRCLE: return {circles.x1[s], circles.y1[s], circles.x2[s], circles.y2[s]};
+                case TRIANGLE: return triangles[s].box;
+                default: return polygons[s].box;
+            }
+        }
+
+        [[nodiscard]] bool removed(CRef ref) const {
+            CBox box = boxOf(ref);
+            return box.x1 > box.x2;
+        }
+
+        CRectangles rects;
+        CCircles circles;
+        vector<CTriangleData> triangles;
+        vector<CPolygonData> polygons;
+        vector<CCoord> vertices;    // of all polygons, each one is a contiguous run
+    };
+
+    //  R-tree node, its children are nodes[first .. first + count) or, in a leaf, treeItems[first .. first + count)
+    struct CNode {
+        CBox box;
+        size_t first, count;
+        bool leaf;
+    };
+
+    //  what a rebuild makes of the live shapes: the arrays sorted by ID, the index of the layout and the raster;
+    //  never changed afterwards, the states share it until the next rebuild
+    struct CIndexed {
+        CShapes shapes;
+        CBox extent{0, 0, -1, -1};  // of the whole scene
+        long cols = 0, rows = 0;
+        vector<size_t> cellStart;   // shapes of cell c are cellShapes[cellStart[c] .. cellStart[c + 1])
+        vector<CRef> cellShapes;
+        vector<CNode> nodes;        // R-tree, level by level from the leaves, root last; with the grid of just the
+                                    // shapes covering more than LARGE_CELLS cells, none if there are none
+        vector<CRef> treeItems;     // shapes of the leaves
+        CBox rasterRegion{0, 0, -1, -1};
+        long rasterSide = 0;            // of a tile, no raster with 0
+        long rasterCols = 0;
+        vector<size_t> tileIdStart;     // shapes containing tile t are tileIds[tileIdStart[t] .. tileIdStart[t + 1])
+        vector<int> tileIds;
+        vector<size_t> tileRefStart;    // shapes crossing tile t are tileRefs[tileRefStart[t] .. tileRefStart[t + 1])
+        vector<CRef> tileRefs;
+    };
+
+    //  appends the IDs hit by the point to ids and sorts just them
+    void collect(int x, int y, vector<int> &ids) const {
+        size_t first = ids.size();
+        if (index) {
+            collectIndexed(*index, x, y, ids);
+            dropHidden(ids, first, hidden);
+        }
+        if (recent) {
+            size_t at = ids.size();
+            collectIndexed(*recent, x, y, ids);
+            dropHidden(ids, at, recentHidden);
+        }
+        for (unsigned kind = 0; kind < KINDS; kind++)
+            testSlots(delta, kind, nullptr, delta.count(kind), x, y, ids);
+        sort(ids.begin() + (long) first, ids.end());
+        if (counters->enabled.get()) counters->record(ids.size() - first);
+    }
+
+    //  visit(ref) for the shapes of the index in the cells or nodes the area overlaps
+    template<typename F_>
+    void visitIndexed(const CIndexed &ix, const CBox &area, F_ visit) const {
+        if (!overlaps(ix.extent, area)) return;
+        if (layout == CScreenLayout::RTREE) visitTree(ix, area, visit);
+        else {
+            long width = ix.extent.x2 - ix.extent.x1 + 1, height = ix.extent.y2 - ix.extent.y1 + 1;
+            auto colOf = [&](long x) { return (x - ix.extent.x1) * ix.cols / width; };
+            auto rowOf = [&](long y) { return (y - ix.extent.y1) * ix.rows / height; };
+            CBox cells{colOf(max(area.x1, ix.extent.x1)), rowOf(max(area.y1, ix.extent.y1)),
+                       colOf(min(area.x2, ix.extent.x2)), rowOf(min(area.y2, ix.extent.y2))};
+            forCells(ix.cols, cells, [&](size_t cell) {
+                for (size_t i = ix.cellStart[cell]; i < ix.cellStart[cell + 1]; i++) {
+                    //  a shape listed in more cells is taken in the one with the corner of its overlap with the area
+                    CBox box = ix.shapes.boxOf(ix.cellShapes[i]);
+                    if ((size_t) (rowOf(max(box.y1, area.y1)) * ix.cols + colOf(max(box.x1, area.x1))) == cell)
+                        visit(ix.cellShapes[i]);
+                }
+            });
+            if (!ix.nodes.empty()) visitTree(ix, area, visit);
+        }
+    }
+
+    //  visit(ref) for the shapes in the leaves of the tree whose boxes overlap the area
+    template<typename F_>
+    static void visitTree(const CIndexed &ix, const CBox &area, F_ &visit) {
+        size_t stack[NODE * 16], depth = 0;
+        stack[depth++] = ix.nodes.size() - 1;
+        while (depth) {
+            const CNode &node = ix.nodes[stack[--depth]];
+            for (size_t i = node.first; i < node.first + node.count; i++)
+                if (node.leaf) visit(ix.treeItems[i]);
+                else if (overlaps(ix.nodes[i].box, area)) stack[depth++] = i;
+        }
+    }
+
+    //  appends the IDs of the shapes of the index hit by the point, from the raster if it covers the point
+    void collectIndexed(const CIndexed &ix, int x, int y, vector<int> &ids) const {
+        if (ix.rasterSide && ix.rasterRegion.contains(x, y)) {
+            size_t tile = (size_t) ((y - ix.rasterRegion.y1) / ix.rasterSide * ix.rasterCols
+                                    + (x - ix.rasterRegion.x1) / ix.rasterSide);
+            ids.insert(ids.end(), ix.tileIds.begin() + (long) ix.tileIdStart[tile],
+                       ix.tileIds.begin() + (long) ix.tileIdStart[tile + 1]);
+            testRefs(ix.shapes, ix.tileRefs.data() + ix.tileRefStart[tile], ix.tileRefs.data() + ix.tileRefStart[tile + 1],
+                     x, y, ids);
+        } else if (ix.extent.contains(x, y)) {
+            if (layout == CScreenLayout::RTREE) testTree(ix, x, y, ids);
+            else {
+                long col = (x - ix.extent.x1) * ix.cols / (ix.extent.x2 - ix.extent.x1 + 1);
+                long row = (y - ix.extent.y1) * ix.rows / (ix.extent.y2 - ix.extent.y1 + 1);
+                size_t cell = (size_t) (row * ix.cols + col);
+                testRefs(ix.shapes, ix.cellShapes.data() + ix.cellStart[cell], ix.cellShapes.data() + ix.cellStart[cell + 1],
+                         x, y, ids);
+                if (!ix.nodes.empty()) testTree(ix, x, y, ids);
+            }
+        }
+    }
+
+    //  drops ids[first ..] an index answered for shapes removed or moved since it was built, gone lists their IDs
+    static void dropHidden(vector<int> &ids, size_t first, const vector<int> &gone) {
+        if (gone.empty()) return;
+        ids.erase(remove_if(ids.begin() + (long) first, ids.end(),
+                            [&gone](int id) { return binary_search(gone.begin(), gone.end(), id); }),
+                  ids.end());
+    }
+
+    //  shapes of the index with the ID, none once it is in gone; every kind of an index is sorted by ID
+    [[nodiscard]] static vector<CRef> indexedFind(const CIndexed *ix, const vector<int> &gone, int id) {
+        vector<CRef> res;
+        if (!ix || binary_search(gone.begin(), gone.end(), id)) return res;
+        const CShapes &shapes = ix->shapes;
+        for (unsigned kind = 0; kind < KINDS; kind++) {
+            size_t slot = 0, last = shapes.count(kind);
+            while (slot < last) {
+                size_t mid = (slot + last) / 2;
+                if (shapes.idOf(kind, mid) < id) slot = mid + 1;
+                else last = mid;
+            }
+            for (; slot < shapes.count(kind) && shapes.idOf(kind, slot) == id; slot++) res.push_back(kind << KIND_SHIFT | (CRef) slot);
+        }
+        return res;
+    }
+
+    static void hide(vector<int> &gone, int id) { gone.insert(lower_bound(gone.begin(), gone.end(), id), id); }
+
+    //  Z-order of a point, the coordinates are shifted to unsigned so that the order follows the plane
+    static uint64_t morton(const CCoord &point) {
+        auto spread = [](uint64_t v) {
+            v = (v | v << 16) & 0x0000FFFF0000FFFFull;
+            v = (v | v << 8) & 0x00FF00FF00FF00FFull;
+            v = (v | v << 4) & 0x0F0F0F0F0F0F0F0Full;
+            v = (v | v << 2) & 0x3333333333333333ull;
+            return (v | v << 1) & 0x5555555555555555ull;
+        };
+        return spread((uint32_t) point.m_X ^ 0x80000000u) | spread((uint32_t) point.m_Y ^ 0x80000000u) << 1;
+    }
+
+    static bool overlaps(const CBox &a, const CBox &b) {
+        return max(a.x1, b.x1) <= min(a.x2, b.x2) && max(a.y1, b.y1) <= min(a.y2, b.y2);
+    }
+
+    static bool inside(const CBox &a, const CBox &b) {
+        return b.x1 <= a.x1 && a.x2 <= b.x2 && b.y1 <= a.y1 && a.y2 <= b.y2;
+    }
+
+    //  the shape shares a point with the area or, with contained, lies inside it; the box of a removed slot is empty
+    [[nodiscard]] bool meets(const CShapes &shapes, CRef ref, const CBox &area, bool contained) const {
+        size_t s = ref & SLOT_MASK;
+        CBox box = shapes.boxOf(ref);
+        bool counting = counters->enabled.get();
+        if (counting) counters->candidates.add(1);
+        if (!overlaps(box, area)) return false;
+        if (counting && ref >> KIND_SHIFT != RECTANGLE && !contained) counters->exactTests.add(1);
+        switch (ref >> KIND_SHIFT) {
+            case RECTANGLE: return !contained || inside(box, area);
+            case CIRCLE: {
+                long cx = shapes.circles.x[s], cy = shapes.circles.y[s], r = labs((long) shapes.circles.r[s]);
+                if (contained) return inside({cx - r, cy - r, cx + r, cy + r}, area);
+                //  the point of the area closest to the centre
+                return CCircle::contains(cx, cy, r, clamp(cx, area.x1, area.x2), clamp(cy, area.y1, area.y2));
+            }
+            case TRIANGLE: {
+                const CTriangleData &t = shapes.triangles[s];
+                if (contained) return inside(box, area);
+                long xs[] = {t.xa, t.xb, t.xc}, ys[] = {t.ya, t.yb, t.yc};
+                CWide turn = (CWide) (t.xb - t.xa) * (t.yc - t.ya) - (CWide) (t.yb - t.ya) * (t.xc - t.xa);
+                return !separated(3, [&](size_t i) { return make_pair(xs[i], ys[i]); }, turn, area);
+            }
+            default: {
+                const CPolygonData &p = shapes.polygons[s];
+                if (p.count == 0) return false;
+                if (contained) return inside(box, area);
+                const CCoord *coords = shapes.vertices.data() + p.first;
+                return !separated(p.count, [coords](size_t i) { return make_pair((long) coords[i].m_X, (long) coords[i].m_Y); },
+                                  p.count >= 3 ? 1 : 0, area);
+            }
+        }
+    }
+
+    //  separating axis test of a convex shape whose box overlaps the area: the line through one of its edges leaves
+    //  every corner of the area strictly outside; turn > 0 for counter-clockwise vertices, < 0 for clockwise ones,
+    //  0 for a segment, outside of which are both sides
+    template<typename F_>
+    static bool separated(size_t count, F_ at, CWide turn, const CBox &area) {
+        const long corners[4][2] = {{area.x1, area.y1}, {area.x2, area.y1}, {area.x1, area.y2}, {area.x2, area.y2}};
+        for (size_t i = 0; i < count; i++) {
+            auto [ax, ay] = at(i);
+            auto [bx, by] = at((i + 1) % count);
+            if (ax == bx && ay == by) continue;
+            bool right = true, left = true;
+            for (const auto &c: corners) {
+                CWide side = (CWide) (bx - ax) * (c[1] - ay) - (CWide) (by - ay) * (c[0] - ax);
+                right &= side < 0;
+                left &= side > 0;
+            }
+            if ((right && turn >= 0) || (left && turn <= 0)) return true;
+        }
+        return false;
+    }
+
+    static CBox merged(const CBox &a, const CBox &b) {
+        return {min(a.x1, b.x1), min(a.y1, b.y1), max(a.x2, b.x2), max(a.y2, b.y2)};
+    }
+
+    //  tests count shapes of one kind, the slots are listed by refs or, without refs, are 0 .. count - 1;
+    //  one loop per kind, no virtual calls
+    void testSlots(const CShapes &shapes, unsigned kind, const CRef *refs, size_t count, int x, int y, vector<int> &ids) const {
+        if (counters->enabled.get()) account(shapes, kind, refs, count, x, y);
+        switch (kind) {
+            case RECTANGLE:
+                testRectangles(shapes.rects, refs, count, x, y, ids);
+                break;
+            case CIRCLE:
+                testCircles(shapes.circles, refs, count, x, y, ids);
+                break;
+            case TRIANGLE:
+                for (size_t i = 0; i < count; i++) {
+                    const CTriangleData &t = shapes.triangles[slotOf(refs, i)];
+                    if (t.box.contains(x, y) && CTriangle::contains(t.xa, t.ya, t.xb, t.yb, t.xc, t.yc, x, y))
+                        ids.push_back(t.id);
+                }
+                break;
+            default:
+                for (size_t i = 0; i < count; i++) {
+                    const CPolygonData &p = shapes.polygons[slotOf(refs, i)];
+                    if (p.box.contains(x, y) && CPolygon::contains(shapes.vertices.data() + p.first, p.count, CCoord(x, y)))
+                        ids.push_back(p.id);
+                }
+        }
+    }
+
+    static size_t slotOf(const CRef *refs, size_t i) { return refs ? refs[i] & SLOT_MASK : i; }
+
+    //  counts the candidates testSlots gets and those of them whose box holds the point and need the geometry
+    void account(const CShapes &shapes, unsigned kind, const CRef *refs, size_t count, int x, int y) const {
+        size_t exact = 0;
+        if (kind != RECTANGLE)
+            for (size_t i = 0; i < count; i++) exact += shapes.boxOf(kind << KIND_SHIFT | (CRef) slotOf(refs, i)).contains(x, y);
+        counters->candidates.add(count);
+        counters->exactTests.add(exact);
+    }
+
+    //  8 (AVX2) or 4 (SSE2) rectangles per step with 32-bit compares, the rest one by one
+    void testRectangles(const CRectangles &rects, const CRef *refs, size_t count, int x, int y, vector<int> &ids) const {
+        size_t i = 0;
+#if defined(CSCREEN_SIMD) && defined(__AVX2__)
+        const __m256i px = _mm256_set1_epi32(x), py = _mm256_set1_epi32(y);
+        for (; i + 8 <= count; i += 8) {
+            __m256i slots = slots8(refs, i);
+            __m256i outside = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpgt_epi32(gather8(rects.x1, slots), px), _mm256_cmpgt_epi32(px, gather8(rects.x2, slots))),
+                    _mm256_or_si256(_mm256_cmpgt_epi32(gather8(rects.y1, slots), py), _mm256_cmpgt_epi32(py, gather8(rects.y2, slots))));
+            compressStore(~(unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF, gather8(rects.id, slots), ids);
+        }
+#elif defined(CSCREEN_SIMD)
+        for (; i + 4 <= count; i += 4) {
+            size_t s[4] = {slotOf(refs, i), slotOf(refs, i + 1), slotOf(refs, i + 2), slotOf(refs, i + 3)};
+            for (unsigned mask = boxMask4(rects.x1, rects.y1, rects.x2, rects.y2, s, x, y); mask; mask &= mask - 1)
+                ids.push_back(rects.id[s[__builtin_ctz(mask)]]);
+        }
+#endif
+        for (; i < count; i++) {
+            size_t s = slotOf(refs, i);
+            if (rects.x1[s] <= x && x <= rects.x2[s] && rects.y1[s] <= y && y <= rects.y2[s]) ids.push_back(rects.id[s]);
+        }
+    }
+
+    //  AVX2 decides 8 circles per step exactly like CCircle::contains, in 64-bit lanes: |dx| <= r, |dy| <= r
+    //  and dx^2 + dy^2 <= r^2 unsigned, plus the x range of the box, which rejects removed circles; SSE2 filters
+    //  4 circles per step by their boxes and verifies the rest
+    void testCircles(const CCircles &circles, const CRef *refs, size_t count, int x, int y, vector<int> &ids) const {
+        size_t i = 0;
+#if defined(CSCREEN_SIMD) && defined(__AVX2__)
+        const __m256i px = _mm256_set1_epi64x(x), py = _mm256_set1_epi64x(y), px32 = _mm256_set1_epi32(x);
+        //  outside mask of 4 circles
+        auto outside4 = [&px, &py](__m128i cx, __m128i cy, __m128i r) {
+            const __m256i zero = _mm256_setzero_si256(), sign = _mm256_set1_epi64x(LLONG_MIN);
+            auto abs64 = [&zero](__m256i v) {
+                return _mm256_blendv_epi8(v, _mm256_sub_epi64(zero, v), _mm256_cmpgt_epi64(zero, v));
+            };
+            __m256i dx = abs64(_mm256_sub_epi64(px, _mm256_cvtepi32_epi64(cx)));
+            __m256i dy = abs64(_mm256_sub_epi64(py, _mm256_cvtepi32_epi64(cy)));
+            __m256i radius = _mm256_cvtepu32_epi64(_mm_abs_epi32(r));
+            //  the squares only matter where both distances fit into 32 bits, mul_epu32 takes the low halves
+            __m256i sum = _mm256_add_epi64(_mm256_mul_epu32(dx, dx), _mm256_mul_epu32(dy, dy));
+            __m256i far = _mm256_cmpgt_epi64(_mm256_xor_si256(sum, sign),
+                                             _mm256_xor_si256(_mm256_mul_epu32(radius, radius), sign));
+            return _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi64(dx, radius), _mm256_cmpgt_epi64(dy, radius)), far);
+        };
+        for (; i + 8 <= count; i += 8) {
+            __m256i slots = slots8(refs, i);
+            __m256i cx = gather8(circles.x, slots), cy = gather8(circles.y, slots), r = gather8(circles.r, slots);
+            __m256i lo = outside4(_mm256_castsi256_si128(cx), _mm256_castsi256_si128(cy), _mm256_castsi256_si128(r));
+            __m256i hi = outside4(_mm256_extracti128_si256(cx, 1), _mm256_extracti128_si256(cy, 1),
+                                  _mm256_extracti128_si256(r, 1));
+            __m256i columns = _mm256_or_si256(_mm256_cmpgt_epi32(gather8(circles.x1, slots), px32),
+                                              _mm256_cmpgt_epi32(px32, gather8(circles.x2, slots)));
+            unsigned outside = (unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(lo))
+                               | (unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(hi)) << 4
+                               | (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(columns));
+            compressStore(~outside & 0xFF, gather8(circles.id, slots), ids);
+        }
+#elif defined(CSCREEN_SIMD)
+        for (; i + 4 <= count; i += 4) {
+            size_t s[4] = {slotOf(refs, i), slotOf(refs, i + 1), slotOf(refs, i + 2), slotOf(refs, i + 3)};
+            for (unsigned mask = boxMask4(circles.x1, circles.y1, circles.x2, circles.y2, s, x, y); mask; mask &= mask - 1) {
+                size_t slot = s[__builtin_ctz(mask)];
+                if (CCircle::contains(circles.x[slot], circles.y[slot], circles.r[slot], x, y))
+                    ids.push_back(circles.id[slot]);
+            }
+        }
+#endif
+        for (; i < count; i++) {
+            size_t s = slotOf(refs, i);
+            if (circles.x1[s] <= x && x <= circles.x2[s] && CCircle::contains(circles.x[s], circles.y[s], circles.r[s], x, y))
+                ids.push_back(circles.id[s]);
+        }
+    }
+
+#if defined(CSCREEN_SIMD) && defined(__AVX2__)
+    static __m256i slots8(const CRef *refs, size_t i) {
+        if (!refs) return _mm256_add_epi32(_mm256_set1_epi32((int) i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        return _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (refs + i)), _mm256_set1_epi32((int) SLOT_MASK));
+    }
+
+    static __m256i gather8(const vector<int> &column, __m256i slots) {
+        return _mm256_i32gather_epi32(column.data(), slots, 4);
+    }
+
+    //  appends the lanes of values selected by mask: a permutation from the table moves them to the front,
+    //  all 8 lanes are stored and the size is cut to the selected ones
+    static void compressStore(unsigned mask, __m256i values, vector<int> &ids) {
+        static const array<array<int, 8>, 256> moves = [] {
+            array<array<int, 8>, 256> res{};
+            for (unsigned m = 0; m < 256; m++)
+                for (int lane = 0, at = 0; lane < 8; lane++)
+                    if (m >> lane & 1) res[m][at++] = lane;
+            return res;
+        }();
+        if (!mask) return;
+        size_t at = ids.size();
+        ids.resize(at + 8);
+        __m256i packed = _mm256_permutevar8x32_epi32(values, _mm256_loadu_si256((const __m256i *) moves[mask].data()));
+        _mm256_storeu_si256((__m256i *) (ids.data() + at), packed);
+        ids.resize(at + (size_t) __builtin_popcount(mask));
+    }
+#elif defined(CSCREEN_SIMD)
+    //  lanes of the 4 slots whose box contains the point
+    static unsigned boxMask4(const vector<int> &x1, const vector<int> &y1, const vector<int> &x2, const vector<int> &y2,
+                             const size_t *s, int x, int y) {
+        auto load = [s](const vector<int> &column) { return _mm_setr_epi32(column[s[0]], column[s[1]], column[s[2]], column[s[3]]); };
+        const __m128i px = _mm_set1_epi32(x), py = _mm_set1_epi32(y);
+        __m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(load(x1), px), _mm_cmpgt_epi32(px, load(x2))),
+                                       _mm_or_si128(_mm_cmpgt_epi32(load(y1), py), _mm_cmpgt_epi32(py, load(y2))));
+        return ~(unsigned) _mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+    }
+#endif
+
+    //  references sorted by kind, every run of one kind is tested by its loop
+    void testRefs(const CShapes &shapes, const CRef *first, const CRef *last, int x, int y, vector<int> &ids) const {
+        while (first != last) {
+            unsigned kind = *first >> KIND_SHIFT;
+            const CRef *run = first;
+            while (run != last && *run >> KIND_SHIFT == kind) run++;
+            testSlots(shapes, kind, first, (size_t) (run - first), x, y, ids);
+            first = run;
+        }
+    }
+
+    //  buckets the shapes into a uniform grid over the scene with about one cell per shape; shapes covering
+    //  many cells go to an R-tree instead, so that a test checks one cell and the few large shapes whose boxes hold
+    //  the point
+    static void buildGrid(CIndexed &ix, const vector<CRef> &refs, const vector<CBox> &boxes) {
+        const CBox &extent = ix.extent;
+        double width = (double) max(extent.x2 - extent.x1 + 1, 1L), height = (double) max(extent.y2 - extent.y1 + 1, 1L);
+        double n = (double) refs.size();
+        long cols = ix.cols = max(1L, min((long) width, (long) sqrt(n * width / height)));
+        long rows = ix.rows = max(1L, min((long) height, (long) (n / (double) cols)));
+
+        vector<size_t> &cellStart = ix.cellStart;
+        cellStart.assign((size_t) (rows * cols + 1), 0);
+        vector<CBox> cells(refs.size());
+        vector<bool> isLarge(refs.size());
+        vector<CRef> large;
+        vector<CBox> largeBoxes;
+        for (size_t i = 0; i < refs.size(); i++) {
+            cells[i] = {(boxes[i].x1 - extent.x1) * cols / (extent.x2 - extent.x1 + 1),
+                        (boxes[i].y1 - extent.y1) * rows / (extent.y2 - extent.y1 + 1),
+                        (boxes[i].x2 - extent.x1) * cols / (extent.x2 - extent.x1 + 1),
+                        (boxes[i].y2 - extent.y1) * rows / (extent.y2 - extent.y1 + 1)};
+            isLarge[i] = (cells[i].x2 - cells[i].x1 + 1) * (cells[i].y2 - cells[i].y1 + 1) > LARGE_CELLS;
+            if (isLarge[i]) {
+                large.push_back(refs[i]);
+                largeBoxes.push_back(boxes[i]);
+            } else forCells(cols, cells[i], [&cellStart](size_t cell) { cellStart[cell + 1]++; });
+        }
+        for (size_t cell = 1; cell < cellStart.size(); cell++) cellStart[cell] += cellStart[cell - 1];
+        ix.cellShapes.resize(cellStart.back());
+        vector<size_t> fill(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < refs.size(); i++)
+            if (!isLarge[i]) forCells(cols, cells[i], [&](size_t cell) { ix.cellShapes[fill[cell]++] = refs[i]; });
+        buildTree(ix, large, largeBoxes);
+    }
+
+    //  a new index of the live shapes that are not hidden: with whole of all of them and with the raster, else of
+    //  the recent index and the delta only; the current ones stay as they are for whoever still reads them
+    [[nodiscard]] shared_ptr<const CIndexed> rebuild(bool whole) const {
+        auto res = make_shared<CIndexed>();
+        CShapes &shapes = res->shapes;
+        auto take = [&shapes](const CIndexed *ix, const vector<int> &gone) {
+            if (ix)
+                for (unsigned kind = 0; kind < KINDS; kind++)
+                    for (size_t slot = 0; slot < ix->shapes.count(kind); slot++)
+                        if (!binary_search(gone.begin(), gone.end(), ix->shapes.idOf(kind, slot)))
+                            shapes.append(ix->shapes, kind << KIND_SHIFT | (CRef) slot);
+        };
+        if (whole) take(index.get(), hidden);
+        take(recent.get(), recentHidden);
+        for (unsigned kind = 0; kind < KINDS; kind++)
+            for (size_t slot = 0; slot < delta.count(kind); slot++)
+                if (!delta.removed(kind << KIND_SHIFT | (CRef) slot)) shapes.append(delta, kind << KIND_SHIFT | (CRef) slot);
+        shapes.sortById();
+
+        //  references in ascending order, so every list built from them in this order is sorted by kind
+        vector<CRef> refs;
+        vector<CBox> boxes;
+        for (unsigned kind = 0; kind < KINDS; kind++)
+            for (size_t slot = 0; slot < shapes.count(kind); slot++) {
+                refs.push_back(kind << KIND_SHIFT | (CRef) slot);
+                boxes.push_back(shapes.boxOf(refs.back()));
+            }
+        for (size_t i = 0; i < boxes.size(); i++) res->extent = i == 0 ? boxes[i] : merged(res->extent, boxes[i]);
+        if (layout == CScreenLayout::RTREE) buildTree(*res, refs, boxes);
+        else buildGrid(*res, refs, boxes);
+        if (whole) buildRaster(*res);
+        return res;
+    }
+
+    //  the raster over the region clipped to int, with the smallest tiles from raster.tile up whose lists fit into
+    //  the budget, none if even a single tile does not; shapes are convex, so one containing the corners of a tile
+    //  contains all of it. Sides are tried by the number of tiles the boxes cross alone, the corners are tested on
+    //  the side kept only
+    void buildRaster(CIndexed &ix) const {
+        const CBox &region = ix.rasterRegion = {max(raster.region.x1, COORD_MIN), max(raster.region.y1, COORD_MIN),
+                                                min(raster.region.x2, COORD_MAX), min(raster.region.y2, COORD_MAX)};
+        if (region.x1 > region.x2 || region.y1 > region.y2) return;
+
+        long width = region.x2 - region.x1 + 1, height = region.y2 - region.y1 + 1;
+        vector<CRef> refs;
+        vector<CBox> boxes;
+        for (unsigned kind = 0; kind < KINDS; kind++)
+            for (size_t slot = 0; slot < ix.shapes.count(kind); slot++) {
+                refs.push_back(kind << KIND_SHIFT | (CRef) slot);
+                boxes.push_back(ix.shapes.boxOf(refs.back()));
+            }
+        //  tiles of the side the box crosses, as columns and rows; none if it misses the region
+        auto span = [&region](const CBox &box, long side) {
+            if (box.x2 < region.x1 || box.x1 > region.x2 || box.y2 < region.y1 || box.y1 > region.y2) return NOWHERE;
+            return CBox{(max(box.x1, region.x1) - region.x1) / side, (max(box.y1, region.y1) - region.y1) / side,
+                        (min(box.x2, region.x2) - region.x1) / side, (min(box.y2, region.y2) - region.y1) / side};
+        };
+        //  the exact tests straight, building is no query the counters should see
+        const CShapes &shapes = ix.shapes;
+        auto contains = [&shapes](CRef ref, long x, long y) {
+            size_t s = ref & SLOT_MASK;
+            switch (ref >> KIND_SHIFT) {
+                case RECTANGLE: return shapes.boxOf(ref).contains(x, y);
+                case CIRCLE: return CCircle::contains(shapes.circles.x[s], shapes.circles.y[s], shapes.circles.r[s], x, y);
+                case TRIANGLE: {
+                    const CTriangleData &t = shapes.triangles[s];
+                    return CTriangle::contains(t.xa, t.ya, t.xb, t.yb, t.xc, t.yc, x, y);
+                }
+                default: {
+                    const CPolygonData &p = shapes.polygons[s];
+                    return CPolygon::contains(shapes.vertices.data() + p.first, p.count, CCoord((int) x, (int) y));
+                }
+            }
+        };
+
+        for (long side = max(1L, raster.tile);; side *= 2) {
+            long tileCols = (width + side - 1) / side, tileRows = (height + side - 1) / side;
+            double table = ((double) tileCols * (double) tileRows + 1) * 2 * sizeof(size_t);
+            bool last = tileCols == 1 && tileRows == 1;
+            //  every entry takes an int whether the tile lies inside the shape or not, counting stops past the budget
+            double room = ((double) raster.budget - table) / (double) max(sizeof(int), sizeof(CRef)), entries = 0;
+            for (size_t i = 0; i < boxes.size() && entries <= room; i++) {
+                CBox tiles = span(boxes[i], side);
+                entries += (double) (tiles.x2 - tiles.x1 + 1) * (double) (tiles.y2 - tiles.y1 + 1);
+            }
+            if (entries > room) {
+                if (last) return;
+                continue;
+            }
+
+            //  whole[entry] for the tiles of the shapes in ascending order, the lists are filled from it
+            vector<bool> whole;
+            whole.reserve((size_t) entries);
+            size_t tiles = (size_t) (tileCols * tileRows), wholes = 0;
+            ix.tileIdStart.assign(tiles + 1, 0);
+            ix.tileRefStart.assign(tiles + 1, 0);
+            for (size_t i = 0; i < refs.size(); i++) {
+                CBox cells = span(boxes[i], side);
+                for (long row = cells.y1; row <= cells.y2; row++)
+                    for (long col = cells.x1; col <= cells.x2; col++) {
+                        long x1 = region.x1 + col * side, y1 = region.y1 + row * side;
+                        long x2 = min(region.x2, x1 + side - 1), y2 = min(region.y2, y1 + side - 1);
+                        whole.push_back(contains(refs[i], x1, y1) && contains(refs[i], x2, y1)
+                                        && contains(refs[i], x1, y2) && contains(refs[i], x2, y2));
+                        wholes += whole.back();
+                        (whole.back() ? ix.tileIdStart : ix.tileRefStart)[(size_t) (row * tileCols + col) + 1]++;
+                    }
+            }
+            for (size_t t = 1; t <= tiles; t++) {
+                ix.tileIdStart[t] += ix.tileIdStart[t - 1];
+                ix.tileRefStart[t] += ix.tileRefStart[t - 1];
+            }
+            ix.tileIds.resize(wholes);
+            ix.tileRefs.resize(whole.size() - wholes);
+            vector<size_t> idFill(ix.tileIdStart.begin(), ix.tileIdStart.end() - 1);
+            vector<size_t> refFill(ix.tileRefStart.begin(), ix.tileRefStart.end() - 1);
+            //  the shapes are visited in ascending order, so the crossing shapes of a tile are sorted by kind
+            size_t entry = 0;
+            for (size_t i = 0; i < refs.size(); i++)
+                forCells(tileCols, span(boxes[i], side), [&](size_t tile) {
+                    if (whole[entry++]) ix.tileIds[idFill[tile]++] = ix.shapes.idOf(refs[i] >> KIND_SHIFT, refs[i] & SLOT_MASK);
+                    else ix.tileRefs[refFill[tile]++] = refs[i];
+                });
+            ix.rasterSide = side;
+            ix.rasterCols = tileCols;
+            return;
+        }
+    }
+
+    //  Sort-Tile-Recursive bulk load: every level is sorted into vertical slices by box center x, each slice
+    //  by center y, and packed NODE entries per node; the nodes of a level are contiguous and the root is last
+    static void buildTree(CIndexed &ix, const vector<CRef> &refs, const vector<CBox> &boxes) {
+        vector<CNode> &nodes = ix.nodes;
+        vector<size_t> items(refs.size());
+        for (size_t i = 0; i < items.size(); i++) items[i] = i;
+        tileOrder(items.begin(), items.end(), [&boxes](size_t i) { return boxes[i]; });
+        vector<CRef> &treeItems = ix.treeItems;
+        treeItems.resize(refs.size());
+        for (size_t b = 0; b < items.size(); b += NODE) {
+            CNode node{boxes[items[b]], b, min(NODE, items.size() - b), true};
+            for (size_t i = b; i < b + node.count; i++) {
+                node.box = merged(node.box, boxes[items[i]]);
+                treeItems[i] = refs[items[i]];
+            }
+            //  a leaf lists its shapes by kind
+            sort(treeItems.begin() + (long) b, treeItems.begin() + (long) (b + node.count));
+            nodes.push_back(node);
+        }
+        for (size_t level = 0; nodes.size() - level > 1;) {
+            auto first = nodes.begin() + (long) level;
+            tileOrder(first, nodes.end(), [](const CNode &node) { return node.box; });
+            size_t end = nodes.size();
+            for (size_t b = level; b < end; b += NODE) {
+                CNode node{nodes[b].box, b, min(NODE, end - b), false};
+                for (size_t i = b; i < b + node.count; i++) node.box = merged(node.box, nodes[i].box);
+                nodes.push_back(node);
+            }
+            level = end;
+        }
+    }
+
+    template<typename It_, typename F_>
+    static void tileOrder(It_ first, It_ last, F_ boxOf) {
+        size_t n = (size_t) (last - first), slices = (size_t) ceil(sqrt((double) ((n + NODE - 1) / NODE)));
+        sort(first, last, [&](const auto &a, const auto &b) { return boxOf(a).x1 + boxOf(a).x2 < boxOf(b).x1 + boxOf(b).x2; });
+        for (size_t s = 0; s < n; s += slices * NODE)
+            sort(first + (long) s, first + (long) min(n, s + slices * NODE), [&](const auto &a, const auto &b) {
+                return boxOf(a).y1 + boxOf(a).y2 < boxOf(b).y1 + boxOf(b).y2;
+            });
+    }
+
+    //  depth first from the root, only nodes whose box contains the point are entered
+    void testTree(const CIndexed &ix, int x, int y, vector<int> &ids) const {
+        //  at most NODE - 1 pending siblings per level and fewer than 16 levels below 2^64 shapes
+        size_t stack[NODE * 16], depth = 0;
+        stack[depth++] = ix.nodes.size() - 1;
+        while (depth) {
+            const CNode &node = ix.nodes[stack[--depth]];
+            if (node.leaf) {
+                testRefs(ix.shapes, ix.treeItems.data() + node.first, ix.treeItems.data() + node.first + node.count, x, y, ids);
+                continue;
+            }
+            for (size_t i = node.first; i < node.first + node.count; i++)
+                if (ix.nodes[i].box.contains(x, y)) stack[depth++] = i;
+        }
+    }
+
+    template<typename F_>
+    static void forCells(long cols, const CBox &cells, F_ visit) {
+        for (long row = cells.y1; row <= cells.y2; row++)
+            for (long col = cells.x1; col <= cells.x2; col++) visit((size_t) (row * cols + col));
+    }
+
+    CScreenLayout layout;
+    CScreenRaster raster;
+    shared_ptr<const CIndexed> index;   // built by the last rebuild, none before the first one
+    vector<int> hidden;                 // IDs removed or moved since, sorted; their shapes in the index are gone
+    shared_ptr<const CIndexed> recent;  // changes gathered by optimize since, without a raster
+    vector<int> recentHidden;           // the same for the recent index
+    CShapes delta;                      // shapes added or moved since the last optimize that changed anything
+    shared_ptr<CScreenCounters> counters = make_shared<CScreenCounters>();
+};
+
+//  one thread edits the screen, any number of threads test it at the same time without locks. The screen keeps
+//  two states that share the index: the writer edits the one nobody reads, publishes it by an atomic store and,
+//  once the readers of the other one are gone, repeats the edit there. A reader announces itself in the counter
+//  of the current epoch, the writer flips the epoch after the store and waits for the counter of the old one to
+//  drop to zero. An edit costs twice the edit, optimize builds the new index once and off to the side.
+class CScreen {
+public:
+    explicit CScreen(CScreenLayout layout = CScreenLayout::GRID, const CScreenRaster &raster = {})
+            : states{CScreenState(layout, raster), CScreenState(layout, raster)} {
+        //  one set of counters for both
+        states[1] = states[0];
+    }
+
+    CScreen(const CScreen &) = delete;
+    CScreen &operator=(const CScreen &) = delete;
+
+    void add(const CShape & shape) {
+        write([&shape](CScreenState &state) {
+            state.add(shape);
+            return true;
+        });
+    }
+
+    //  false if there is no shape with the ID
+    bool remove(int id) { return write([id](CScreenState &state) { return state.remove(id); }); }
+
+    bool move(int id, int dx, int dy) { return write([=](CScreenState &state) { return state.move(id, dx, dy); }); }
+
+    //  IDs of the shapes containing the point in ascending order, as of the last edit published
+    [[nodiscard]] vector<int> test(int x, int y) const {
+        return read([x, y](const CScreenState &state) { return state.test(x, y); });
+    }
+
+    [[nodiscard]] vector<int> testRect(int x1, int y1, int x2, int y2, bool contained = false) const {
+        return read([=](const CScreenState &state) { return state.testRect(x1, y1, x2, y2, contained); });
+    }
+
+    //  all points against one state, see CScreenState::testMany
+    [[nodiscard]] CScreenHits testMany(const vector<CCoord> &points, unsigned threads = 0) const {
+        return read([&points, threads](const CScreenState &state) { return state.testMany(points, threads); });
+    }
+
+    //  the other state takes over the index built in the published one instead of building its own
+    void optimize() {
+        CStopwatch watch;
+        bool rebuilt = false;
+        write([&rebuilt](CScreenState &state) { return rebuilt = state.optimize(); },
+              [&rebuilt](CScreenState &state, const CScreenState &published) { if (rebuilt) state = published; });
+        states[0].statistics().optimizeSeconds.set(watch.seconds());
+    }
+
+    //  query counters are off by default, enabling them resets them
+    void enableStats(bool on = true) {
+        CScreenCounters &counters = states[0].statistics();
+        for (auto *counter: {&counters.queries, &counters.candidates, &counters.exactTests, &counters.hits}) counter->set(0);
+        counters.enabled.set(on);
+    }
+
+    [[nodiscard]] CScreenStats stats() const {
+        const CScreenCounters &c = states[0].statistics();
+        return {c.optimizeSeconds.get(), c.queries.get(), c.candidates.get(), c.exactTests.get(), c.hits.get()};
+    }
+private:
+    //  runs the query on the published state, counted as a reader of the current epoch until it returns
+    template<typename F_>
+    auto read(F_ query) const -> decltype(query(declval<const CScreenState &>())) {
+#ifdef CSCREEN_THREADS
+        struct CReader {
+            explicit CReader(const CScreen &screen) {
+                for (;;) {
+                    counter = &screen.readers[screen.epoch.load() & 1];
+                    ++*counter;
+                    //  the writer may have flipped the epoch and be waiting for the old counter already
+                    if (counter == &screen.readers[screen.epoch.load() & 1]) break;
+                    --*counter;
+                }
+            }
+            ~CReader() { --*counter; }
+            atomic<size_t> *counter;
+        } reader(*this);
+        return query(states[published.load()]);
+#else
+        return query(states[0]);
+#endif
+    }
+
+    //  the edit goes to the state nobody reads, which is published then; the other state gets it by replay once
+    //  its readers are gone, without threads there is only the first state
+    template<typename F_, typename G_>
+    auto write(F_ edit, G_ replay) -> decltype(edit(declval<CScreenState &>())) {
+#ifdef CSCREEN_THREADS
+        unsigned back = 1 - published.load();
+        auto res = edit(states[back]);
+        published.store(back);
+        unsigned e = epoch.load();
+        epoch.store(e + 1);
+        while (readers[e & 1].load()) this_thread::yield();
+        replay(states[1 - back], states[back]);
+        return res;
+#else
+        (void) replay;
+        return edit(states[0]);
+#endif
+    }
+
+    //  the replay repeats the edit
+    template<typename F_>
+    auto write(F_ edit) -> decltype(edit(declval<CScreenState &>())) {
+        return write(edit, [&edit](CScreenState &state, const CScreenState &) { edit(state); });
+    }
+
+    CScreenState states[2];
+#ifdef CSCREEN_THREADS
+    atomic<unsigned> published{0};              // the state readers use
+    atomic<unsigned> epoch{0};
+    mutable atomic<size_t> readers[2] = {};     // readers inside each parity of the epoch
+#endif
 };
 
 
@@ -204,6 +1517,356 @@ int main() {
     assert (s3.test(15, 3) == (vector<int>{1, 3}));
     assert (s3.test(11, 10) == (vector<int>{}));
 
+    //  the grid has to answer exactly like testing every shape
+    CScreen s4, s5, s6(CScreenLayout::RTREE);
+    vector<pair<int, unique_ptr<CShape>>> all;
+    srand(4);
+    for (int id = 0; id < 3000; id++) {
+        int x = rand() % 2000 - 1000, y = rand() % 2000 - 1000, size = id % 100 == 0 ? 1500 : 1 + rand() % 40;
+        unique_ptr<CShape> shape;
+        switch (id % 4) {
+            case 0: shape = make_unique<CRectangle>(id, x, y, x + size, y - size / 2); break;
+            case 1: shape = make_unique<CCircle>(id, x, y, size); break;
+            case 2: shape = make_unique<CTriangle>(id, CCoord(x, y), CCoord(x + size, y), CCoord(x, y + size)); break;
+            default: shape = make_unique<CPolygon>(id, CCoord(x, y), CCoord(x + size, y), CCoord(x + size, y + size),
+                                                   CCoord(x, y + size));
+        }
+        s4.add(*shape);
+        s5.add(*shape);
+        s6.add(*shape);
+        all.emplace_back(id, move(shape));
+    }
+    s5.optimize();
+    s6.optimize();
+    for (int i = 0; i < 2000; i++) {
+        int x = rand() % 2600 - 1300, y = rand() % 2600 - 1300;
+        vector<int> expected;
+        for (const auto &shape: all)
+            if (shape.second->hasPoint(CCoord(x, y))) expected.push_back(shape.first);
+        assert (s4.test(x, y) == expected && s5.test(x, y) == expected && s6.test(x, y) == expected);
+    }
+
+    CScreen s7(CScreenLayout::RTREE);
+    s7.add(CRectangle(5000, -100000, -100000, 100000, 100000));
+    for (int id = 0; id < 1000; id++) s7.add(CCircle(id, id * 10, id % 7, 3));
+    s7.add(CPolygon(1000, {CCoord(0, 0), CCoord(9000, 0), CCoord(9000, 5)}));
+    s7.optimize();
+    assert (s7.test(50, 4) == (vector<int>{5, 5000}) && s7.test(-5000, 0) == (vector<int>{5000}));
+    assert (s7.test(8990, 1) == (vector<int>{899, 1000, 5000}) && s7.test(100001, 0).empty());
+
+    //  a raster over the middle of the scene, with tiles that fit, with tiles coarsened to fit a small budget and
+    //  with none at all, answers like hasPoint inside the region and out of it, also after edits
+    CScreen r1(CScreenLayout::GRID, CScreenRaster{{-500, -500, 500, 500}, 8, 64 << 20});
+    CScreen r2(CScreenLayout::RTREE, CScreenRaster{{-600, -400, 300, 700}, 2, 256 << 10});
+    CScreen r3(CScreenLayout::GRID, CScreenRaster{{-500, -500, 500, 500}, 8, 0});
+    for (const auto &shape: all)
+        for (CScreen *screen: {&r1, &r2, &r3}) screen->add(*shape.second);
+    vector<bool> gone(all.size());
+    auto checkRaster = [&](int queries) {
+        for (int i = 0; i < queries; i++) {
+            int x = rand() % 1400 - 700, y = rand() % 1400 - 700;
+            vector<int> expected;
+            for (const auto &shape: all)
+                if (!gone[shape.first] && shape.second->hasPoint(CCoord(x, y))) expected.push_back(shape.first);
+            assert (r1.test(x, y) == expected && r2.test(x, y) == expected && r3.test(x, y) == expected);
+        }
+    };
+    for (CScreen *screen: {&r1, &r2, &r3}) screen->optimize();
+    checkRaster(2000);
+    for (int id = 0; id < 3000; id += 7) {
+        for (CScreen *screen: {&r1, &r2, &r3}) assert (screen->remove(id));
+        gone[id] = true;
+    }
+    checkRaster(500);
+    for (CScreen *screen: {&r1, &r2, &r3}) screen->optimize();
+    checkRaster(500);
+    //  a few edits keep the index and its raster, they are answered from the delta and the hidden IDs
+    for (int id = 1; id < 200; id += 7) {
+        for (CScreen *screen: {&r1, &r2, &r3}) assert (screen->remove(id));
+        gone[id] = true;
+    }
+    for (int id = 2; id < 300; id += 11)
+        for (CScreen *screen: {&r1, &r2, &r3}) assert (screen->move(id, 0, 0) == !gone[id]);
+    for (int id = 3000; id < 3060; id++) {
+        all.emplace_back(id, make_unique<CCircle>(id, rand() % 1000 - 500, rand() % 1000 - 500, 1 + rand() % 60));
+        gone.push_back(false);
+        for (CScreen *screen: {&r1, &r2, &r3}) screen->add(*all.back().second);
+    }
+    checkRaster(500);
+    for (CScreen *screen: {&r1, &r2, &r3}) screen->optimize();
+    checkRaster(1000);
+
+    //  stats count only while enabled and only queries: every shape of a screen never optimized is a candidate,
+    //  the circle's box holds the point and needs the exact test, the far triangle's does not; the raster optimize
+    //  builds adds nothing
+    CScreen counted(CScreenLayout::GRID, CScreenRaster{{0, 0, 20, 20}, 4});
+    counted.add(CRectangle(1, 0, 0, 10, 10));
+    counted.add(CCircle(2, 5, 5, 3));
+    counted.add(CTriangle(3, CCoord(100, 100), CCoord(110, 100), CCoord(100, 110)));
+    assert (counted.test(5, 5) == (vector<int>{1, 2}) && counted.stats().queries == 0);
+    counted.enableStats();
+    assert (counted.test(5, 5) == (vector<int>{1, 2}) && counted.testRect(0, 0, 1, 1) == (vector<int>{1}));
+    CScreenStats cs = counted.stats();
+    assert (cs.queries == 2 && cs.candidates == 6 && cs.exactTests == 1 && cs.hits == 3);
+    counted.optimize();
+    assert (counted.stats().candidates == 6 && counted.stats().exactTests == 1);
+    assert (counted.test(105, 101) == (vector<int>{3}) && counted.stats().queries == 3 && counted.stats().optimizeSeconds > 0);
+
+    //  the grid keeps shapes spanning many cells in a tree, a test or testRect does not check every one of them
+    CScreen strips;
+    for (int k = 0; k < 100; k++) strips.add(CRectangle(k, 0, k * 10, 10000, k * 10 + 5));
+    for (int k = 100; k < 2100; k++) strips.add(CRectangle(k, k * 37 % 10000, k * 53 % 1000, k * 37 % 10000 + 3, k * 53 % 1000 + 3));
+    strips.optimize();
+    strips.enableStats();
+    vector<int> stripHits = strips.test(5000, 502);
+    assert (find(stripHits.begin(), stripHits.end(), 50) != stripHits.end() && strips.stats().candidates < 50);
+    strips.enableStats();
+    assert (strips.testRect(5000, 500, 5001, 501) == vector<int>{50} && strips.stats().candidates < 50);
+
+    //  changes too few to rebuild the index are not left to be tested one by one after optimize
+    CScreen moved;
+    for (int k = 0; k < 2000; k++) moved.add(CRectangle(k, k % 50 * 20, k / 50 * 20, k % 50 * 20 + 10, k / 50 * 20 + 10));
+    moved.optimize();
+    for (int k = 0; k < 100; k++) assert (moved.move(k, 5, 5));
+    moved.optimize();
+    moved.enableStats();
+    assert (moved.test(152, 12) == vector<int>{7} && moved.test(141, 1).empty() && moved.stats().candidates < 20);
+    assert (moved.remove(7) && moved.test(152, 12).empty() && moved.move(8, 1, 0) && moved.test(176, 12) == vector<int>{8});
+
+    //  readers running alongside the writer, from before its first optimize on, see every add in order
+    CScreen live;
+    atomic<bool> writing{true};
+    vector<thread> readersPool;
+    for (int r = 0; r < 3; r++)
+        readersPool.emplace_back([&live, &writing] {
+            size_t seen = 0;
+            while (writing) {
+                vector<int> ids = live.test(0, 0);
+                assert (ids.size() >= seen);
+                for (size_t i = 0; i < ids.size(); i++) assert (ids[i] == (int) i);
+                seen = ids.size();
+            }
+        });
+    for (int id = 0; id < 500; id++) {
+        live.add(CRectangle(id, -id, -id, id, id));
+        if (id % 50 == 49) live.optimize();
+    }
+    writing = false;
+    for (auto &t: readersPool) t.join();
+    assert (live.test(0, 0).size() == 500);
+
+    //  testMany answers like test, in the order of the points, with any number of threads
+    vector<CCoord> points;
+    for (int i = 0; i < 5000; i++) points.emplace_back(rand() % 2600 - 1300, rand() % 2600 - 1300);
+    for (const CScreen *screen: {&s4, &s5, &s6})
+        for (unsigned threads: {1u, 3u, 0u}) {
+            CScreenHits hits = screen->testMany(points, threads);
+            assert (hits.offsets.size() == points.size() + 1 && hits.offsets.back() == hits.ids.size());
+            for (size_t i = 0; i < points.size(); i++)
+                assert (vector<int>(hits.ids.begin() + (long) hits.offsets[i], hits.ids.begin() + (long) hits.offsets[i + 1])
+                        == screen->test(points[i].m_X, points[i].m_Y));
+        }
+    assert (s1.testMany({}).offsets == vector<size_t>{0});
+
+    //  edges and vertices are inside, for triangles and polygons alike
+    assert (CTriangle(1, CCoord(0, 0), CCoord(10, 0), CCoord(0, 10)).hasPoint(CCoord(5, 0)));
+    assert (CTriangle(1, CCoord(0, 0), CCoord(10, 0), CCoord(0, 10)).hasPoint(CCoord(5, 5)));
+    assert (!CTriangle(1, CCoord(0, 0), CCoord(10, 0), CCoord(20, 0)).hasPoint(CCoord(21, 0)));
+    CPolygon square(2, CCoord(10, 10), CCoord(10, 0), CCoord(0, 0), CCoord(0, 10), CCoord(0, 5), CCoord(0, 10));
+    assert (square.hasPoint(CCoord(10, 5)) && square.hasPoint(CCoord(0, 0)) && square.hasPoint(CCoord(3, 10)));
+    assert (!square.hasPoint(CCoord(11, 5)) && !square.hasPoint(CCoord(-1, -1)) && !square.hasPoint(CCoord(5, 11)));
+    assert (CPolygon(3, CCoord(0, 0), CCoord(4, 4), CCoord(2, 2)).hasPoint(CCoord(3, 3)));
+    assert (!CPolygon(3, CCoord(0, 0), CCoord(4, 4), CCoord(2, 2)).hasPoint(CCoord(5, 5)));
+
+    //  a parabola closed at the top makes a convex polygon with thousands of vertices, checked against every edge
+    vector<CCoord> ring;
+    for (int x = -1000; x <= 1000; x++) ring.emplace_back(x, x * x);
+    vector<CCoord> shuffled(ring.rbegin(), ring.rend());
+    rotate(shuffled.begin(), shuffled.begin() + 700, shuffled.end());
+    CPolygon round(4, shuffled.begin(), shuffled.end());
+    CScreen s11;
+    s11.add(round);
+    s11.optimize();
+    for (int i = 0; i < 3000; i++) {
+        int x = rand() % 2200 - 1100;
+        CCoord point = i % 2 ? CCoord(x, x * x + i % 5 - 2) : CCoord(x, rand() % 1100000 - 10);
+        bool inside = true;
+        for (size_t j = 0; j < ring.size(); j++) {
+            const CCoord &a = ring[j], &b = ring[(j + 1) % ring.size()];
+            inside &= ((long) b.m_X - a.m_X) * (point.m_Y - a.m_Y) - ((long) b.m_Y - a.m_Y) * (point.m_X - a.m_X) >= 0;
+        }
+        assert (round.hasPoint(point) == inside && s11.test(point.m_X, point.m_Y) == (inside ? vector<int>{4} : vector<int>{}));
+    }
+
+    //  adds, removals and moves after optimize answer like the scene built from scratch; shapes are kept as
+    //  {id, kind, x, y, size} so the expected ones can be rebuilt after a move
+    auto build = [](const array<int, 5> &d) -> unique_ptr<CShape> {
+        int x = d[2], y = d[3], size = d[4];
+        switch (d[1]) {
+            case 0: return make_unique<CRectangle>(d[0], x, y, x + size, y - size / 2);
+            case 1: return make_unique<CCircle>(d[0], x, y, size);
+            case 2: return make_unique<CTriangle>(d[0], CCoord(x, y), CCoord(x + size, y), CCoord(x, y + size));
+            default: return make_unique<CPolygon>(d[0], CCoord(x, y), CCoord(x + size, y), CCoord(x + size, y + size),
+                                                  CCoord(x, y + size));
+        }
+    };
+    CScreen e1, e2(CScreenLayout::RTREE), e3;
+    vector<array<int, 5>> model;
+    for (int step = 0; step < 3000; step++) {
+        int op = step < 1000 ? 0 : rand() % 3, id = rand() % 1200;
+        if (op == 0) {
+            model.push_back({id, rand() % 4, rand() % 2000 - 1000, rand() % 2000 - 1000, 1 + rand() % (id % 50 ? 40 : 1500)});
+            for (CScreen *screen: {&e1, &e2, &e3}) screen->add(*build(model.back()));
+        } else if (op == 1) {
+            bool found = any_of(model.begin(), model.end(), [id](const array<int, 5> &d) { return d[0] == id; });
+            model.erase(remove_if(model.begin(), model.end(), [id](const array<int, 5> &d) { return d[0] == id; }), model.end());
+            for (CScreen *screen: {&e1, &e2, &e3}) assert (screen->remove(id) == found);
+        } else {
+            int dx = rand() % 200 - 100, dy = rand() % 200 - 100;
+            bool found = false;
+            for (auto &d: model)
+                if (d[0] == id) {
+                    d[2] += dx;
+                    d[3] += dy;
+                    found = true;
+                }
+            for (CScreen *screen: {&e1, &e2, &e3}) assert (screen->move(id, dx, dy) == found);
+        }
+        if (step % 150 == 0) {
+            e1.optimize();
+            e2.optimize();
+        }
+        if (step % 100 == 99) {
+            vector<pair<int, unique_ptr<CShape>>> expectedShapes;
+            for (const auto &d: model) expectedShapes.emplace_back(d[0], build(d));
+            for (int i = 0; i < 200; i++) {
+                int x = rand() % 2400 - 1200, y = rand() % 2400 - 1200;
+                vector<int> expected;
+                for (const auto &shape: expectedShapes)
+                    if (shape.second->hasPoint(CCoord(x, y))) expected.push_back(shape.first);
+                sort(expected.begin(), expected.end());
+                assert (e1.test(x, y) == expected && e2.test(x, y) == expected && e3.test(x, y) == expected);
+            }
+        }
+    }
+
+    //  marquee selection against exact tests written out for the shapes of the model: a rectangle, circle or
+    //  polygon meets the area if a vertex or corner of one lies in the other or their edges cross
+    auto crosses = [](long ax, long ay, long bx, long by, long cx, long cy, long dx, long dy) {
+        auto orient = [](long px, long py, long qx, long qy, long rx, long ry) {
+            long v = (qx - px) * (ry - py) - (qy - py) * (rx - px);
+            return (v > 0) - (v < 0);
+        };
+        return orient(ax, ay, bx, by, cx, cy) * orient(ax, ay, bx, by, dx, dy) <= 0
+               && orient(cx, cy, dx, dy, ax, ay) * orient(cx, cy, dx, dy, bx, by) <= 0
+               && max(min(ax, bx), min(cx, dx)) <= min(max(ax, bx), max(cx, dx))
+               && max(min(ay, by), min(cy, dy)) <= min(max(ay, by), max(cy, dy));
+    };
+    auto selects = [&](const array<int, 5> &d, const CBox &area, bool contained) {
+        long x = d[2], y = d[3], size = d[4];
+        if (d[1] == 1) {
+            if (contained) return area.x1 <= x - size && x + size <= area.x2 && area.y1 <= y - size && y + size <= area.y2;
+            long dx = max({area.x1 - x, 0L, x - area.x2}), dy = max({area.y1 - y, 0L, y - area.y2});
+            return dx * dx + dy * dy <= size * size;
+        }
+        vector<pair<long, long>> shape;
+        switch (d[1]) {
+            case 0: shape = {{x, y}, {x + size, y}, {x + size, y - size / 2}, {x, y - size / 2}}; break;
+            case 2: shape = {{x, y}, {x + size, y}, {x, y + size}}; break;
+            default: shape = {{x, y}, {x + size, y}, {x + size, y + size}, {x, y + size}};
+        }
+        vector<pair<long, long>> corners{{area.x1, area.y1}, {area.x2, area.y1}, {area.x2, area.y2}, {area.x1, area.y2}};
+        bool vertexInside = false, allInside = true;
+        for (auto [vx, vy]: shape) {
+            bool in = area.contains(vx, vy);
+            vertexInside |= in;
+            allInside &= in;
+        }
+        if (contained) return allInside;
+        if (vertexInside) return true;
+        unique_ptr<CShape> real = build(d);
+        for (auto [cx, cy]: corners)
+            if (real->hasPoint(CCoord((int) cx, (int) cy))) return true;
+        for (size_t i = 0; i < shape.size(); i++)
+            for (size_t j = 0; j < corners.size(); j++) {
+                auto a = shape[i], b = shape[(i + 1) % shape.size()], c = corners[j], e = corners[(j + 1) % 4];
+                if (crosses(a.first, a.second, b.first, b.second, c.first, c.second, e.first, e.second)) return true;
+            }
+        return false;
+    };
+    CScreen m1, m2(CScreenLayout::RTREE), m3;
+    vector<array<int, 5>> marquee;
+    for (int id = 0; id < 2000; id++) {
+        marquee.push_back({id, rand() % 4, rand() % 2000 - 1000, rand() % 2000 - 1000, 1 + rand() % (id % 97 ? 40 : 900)});
+        for (CScreen *screen: {&m1, &m2, &m3}) screen->add(*build(marquee.back()));
+    }
+    m1.optimize();
+    m2.optimize();
+    for (int i = 0; i < 600; i++) {
+        int x = rand() % 2400 - 1200, y = rand() % 2400 - 1200, w = rand() % (i % 10 ? 60 : 1200), h = rand() % 60;
+        CBox area{x, y, x + w, y + h};
+        bool contained = i % 3 == 0;
+        vector<int> expected;
+        for (const auto &d: marquee)
+            if (selects(d, area, contained)) expected.push_back(d[0]);
+        for (CScreen *screen: {&m1, &m2, &m3})
+            assert (screen->testRect(x + w, y, x, y + h, contained) == expected);
+    }
+
+    //  the batched rectangle and circle kernels on edges, on circle boundaries and at the ends of int
+    CScreen s8, s9, s10(CScreenLayout::RTREE);
+    vector<pair<int, unique_ptr<CShape>>> edges;
+    const int ends[] = {INT_MIN, INT_MIN + 1, -5, 0, 3, 4, 5, INT_MAX - 1, INT_MAX};
+    for (int id = 0; id < 500; id++) {
+        int x = ends[rand() % 9], y = ends[rand() % 9], r = id % 5 == 0 ? ends[rand() % 9] : rand() % 11 - 5;
+        unique_ptr<CShape> shape;
+        if (id % 2) shape = make_unique<CCircle>(id, x, y, r);
+        else shape = make_unique<CRectangle>(id, x, y, ends[rand() % 9], ends[rand() % 9]);
+        s8.add(*shape);
+        s9.add(*shape);
+        s10.add(*shape);
+        edges.emplace_back(id, move(shape));
+    }
+    s9.optimize();
+    s10.optimize();
+    for (int i = 0; i < 2000; i++) {
+        auto near = [&ends]() { return (int) clamp((long) ends[rand() % 9] + rand() % 11 - 5, (long) INT_MIN, (long) INT_MAX); };
+        int x = near(), y = near();
+        vector<int> expected;
+        for (const auto &shape: edges)
+            if (shape.second->hasPoint(CCoord(x, y))) expected.push_back(shape.first);
+        assert (s8.test(x, y) == expected && s9.test(x, y) == expected && s10.test(x, y) == expected);
+    }
+
+    //  shapes spanning the whole int range, whose cross products do not fit into 64 bits, and an empty polygon;
+    //  the hypotenuse of the triangles is x + y = -1
+    CScreen w1, w2(CScreenLayout::RTREE);
+    vector<CCoord> none;
+    for (CScreen *screen: {&w1, &w2}) {
+        screen->add(CTriangle(1, CCoord(INT_MIN, INT_MIN), CCoord(INT_MAX, INT_MIN), CCoord(INT_MIN, INT_MAX)));
+        screen->add(CPolygon(2, {CCoord(INT_MIN, INT_MIN), CCoord(INT_MAX, INT_MIN), CCoord(INT_MIN, INT_MAX)}));
+        screen->add(CPolygon(3, {CCoord(INT_MIN, INT_MIN), CCoord(INT_MAX, INT_MIN), CCoord(INT_MAX, INT_MAX),
+                                 CCoord(INT_MIN, INT_MAX)}));
+        screen->add(CPolygon(4, none.begin(), none.end()));
+    }
+    w2.optimize();
+    assert (!CPolygon(4, none.begin(), none.end()).hasPoint(CCoord(0, 0)));
+    for (CScreen *screen: {&w1, &w2}) {
+        assert (screen->test(-1, 0) == (vector<int>{1, 2, 3}) && screen->test(0, 0) == (vector<int>{3}));
+        assert (screen->test(INT_MAX, INT_MIN + 1) == (vector<int>{3}) && screen->test(INT_MAX, INT_MAX) == (vector<int>{3}));
+        assert (screen->test(INT_MIN, INT_MAX) == (vector<int>{1, 2, 3}));
+        assert (screen->testRect(0, 0, 10, 10) == (vector<int>{3}) && screen->testRect(-5, -5, 0, 0) == (vector<int>{1, 2, 3}));
+        assert (screen->testRect(INT_MIN, INT_MIN, INT_MAX, INT_MAX, true) == (vector<int>{1, 2, 3}));
+        assert (screen->remove(4));
+    }
+    //  a move out of the int range is refused as a whole, for indexed shapes and for those of the delta alike
+    for (CScreen *screen: {&w1, &w2}) {
+        screen->add(CCircle(5, INT_MAX - 2, 0, 10));
+        assert (!screen->move(1, 1, 0) && !screen->move(3, 0, -1) && !screen->move(5, 5, 0));
+        assert (screen->test(INT_MIN, INT_MAX) == (vector<int>{1, 2, 3}) && screen->test(INT_MIN + 12, 0) == (vector<int>{1, 2, 3}));
+        assert (screen->move(5, 2, -3) && screen->test(INT_MAX, -3) == (vector<int>{3, 5}) && !screen->move(5, 1, 0));
+    }
+
     return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,225 @@
+//  CIndex benchmarks, built against main.cpp the same way Progtest builds it:
+//  g++ -std=c++17 -O2 -pthread bench.cpp -o bench && ./bench [max length] [max threads]
+//  every corpus (random, low entropy, natural text) is indexed at 10^4 .. max length elements as a string,
+//  a vector<int> and a list<string> of words, each with the default and with a custom comparator
+
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <set>
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+#include <queue>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <limits>
+#include <optional>
+#include <fstream>
+#include <type_traits>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define CINDEX_SIMD
+#endif
+#define CINDEX_THREADS
+#define CINDEX_CLOCK
+#define CINDEX_FILES
+
+using namespace std;
+
+#define __PROGTEST__
+#include "main.cpp"
+
+//  resident memory of the process in bytes, the difference around a construction is the index size
+static size_t residentBytes() {
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+//  suffix array construction time of CIndex<string> for 1 .. maxThreads threads
+static void buildScaling(const string &text, unsigned maxThreads) {
+    mt19937 rng(42);
+    vector<string> queries;
+    for (int i = 0; i < 100; i++) queries.push_back(text.substr(rng() % (text.size() - 16), 1 + rng() % 16));
+
+    cout << "construction, " << text.size() << " chars" << endl;
+    cout << setw(8) << "threads" << setw(12) << "seconds" << setw(10) << "speedup" << endl;
+    vector<set<size_t>> expected;
+    double serial = 0;
+    for (unsigned threads = 1;; threads = min(threads * 2, maxThreads)) {
+        auto start = chrono::steady_clock::now();
+        CIndex<string> idx(text, less<char>(), CIndexOptions{threads});
+        double elapsed = secondsSince(start);
+        if (threads == 1) serial = elapsed;
+
+        //  every thread count has to answer exactly like the serial build
+        for (size_t i = 0; i < queries.size(); i++) {
+            auto res = idx.search(queries[i]);
+            if (threads == 1) expected.push_back(res);
+            else if (res != expected[i]) {
+                cout << "mismatch with " << threads << " threads" << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        cout << setw(8) << threads << setw(12) << fixed << setprecision(3) << elapsed
+             << setw(10) << setprecision(2) << serial / elapsed << endl;
+        if (threads >= maxThreads) break;
+    }
+}
+
+//  uniform letters
+static string randomCorpus(size_t length, mt19937 &rng) {
+    string res(length, ' ');
+    for (auto &c: res) c = (char) ('a' + rng() % 26);
+    return res;
+}
+
+//  "aaaa...u" runs, the worst case for comparisons and for the number of hits of short patterns
+static string lowEntropyCorpus(size_t length, mt19937 &rng) {
+    string res(length, 'a');
+    for (size_t i = rng() % 64; i < length; i += 1 + rng() % 64) res[i] = 'u';
+    return res;
+}
+
+//  words drawn from a Zipf-like distribution, with sentence capitals
+static string naturalCorpus(size_t length, mt19937 &rng) {
+    static const vector<string> words{
+            "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be", "by", "on",
+            "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have", "an", "had", "they",
+            "you", "were", "their", "one", "all", "we", "can", "her", "has", "there", "been", "if", "more", "when",
+            "will", "would", "who", "so", "no", "index", "suffix", "pattern", "search", "automaton", "sequence",
+            "element", "comparator", "authentication", "automation", "automotive", "benchmark", "memory"};
+    vector<double> weights;
+    for (size_t i = 0; i < words.size(); i++) weights.push_back(1.0 / (double) (i + 1));
+    discrete_distribution<size_t> pick(weights.begin(), weights.end());
+    string res;
+    bool capital = true;
+    while (res.size() < length) {
+        string word = words[pick(rng)];
+        if (capital) word[0] = (char) toupper(word[0]);
+        capital = rng() % 12 == 0;
+        res += word;
+        res += capital ? ". " : " ";
+    }
+    res.resize(length);
+    return res;
+}
+
+//  words separated by spaces, texts without any split into chunks of 1 .. 8 letters
+static list<string> tokens(const string &text, mt19937 &rng) {
+    list<string> res;
+    if (text.find(' ') != string::npos) {
+        istringstream in(text);
+        for (string word; in >> word;) res.push_back(word);
+    } else
+        for (size_t i = 0; i < text.size();) {
+            size_t len = 1 + rng() % 8;
+            res.push_back(text.substr(i, len));
+            i += len;
+        }
+    return res;
+}
+
+struct CCaseInsensitiveChar {
+    bool operator()(char a, char b) const { return tolower(a) < tolower(b); }
+};
+
+struct CCaseInsensitiveWord {
+    bool operator()(const string &a, const string &b) const {
+        return lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+            return tolower(x) < tolower(y);
+        });
+    }
+};
+
+//  patterns of 1 .. 16 elements taken from the sequence, every tenth one made unlikely to occur
+template<typename T_>
+static vector<T_> sampleQueries(const T_ &seq, const typename T_::value_type &foreign, mt19937 &rng) {
+    vector<typename T_::value_type> elements(seq.begin(), seq.end());
+    vector<T_> res;
+    for (int i = 0; i < 1000 && elements.size() > 16; i++) {
+        size_t len = 1 + rng() % 16, from = rng() % (elements.size() - len);
+        vector<typename T_::value_type> piece(elements.begin() + from, elements.begin() + from + len);
+        if (i % 10 == 0) piece.back() = foreign;
+        res.emplace_back(piece.begin(), piece.end());
+    }
+    return res;
+}
+
+static double percentile(vector<double> &sorted, double p) {
+    return sorted.empty() ? 0 : sorted[min(sorted.size() - 1, (size_t) (p * (double) sorted.size()))];
+}
+
+template<typename T_, typename C_>
+static void measure(const string &corpus, const string &type, const T_ &seq, const C_ &cmp,
+                    const typename T_::value_type &foreign, mt19937 &rng) {
+    size_t before = residentBytes();
+    CIndex<T_, C_> idx(seq, cmp);
+    size_t memory = residentBytes() - min(before, residentBytes());
+    CIndexStats built = idx.stats();
+
+    vector<double> latency;
+    for (const auto &query: sampleQueries(seq, foreign, rng)) {
+        auto start = chrono::steady_clock::now();
+        idx.search(query);
+        latency.push_back(secondsSince(start) * 1e6);
+    }
+    sort(latency.begin(), latency.end());
+    CIndexStats done = idx.stats();
+    cout << setw(12) << corpus << setw(22) << type << setw(10) << distance(seq.begin(), seq.end())
+         << setw(10) << fixed << setprecision(3) << built.buildSeconds
+         << setw(10) << setprecision(1) << percentile(latency, 0.5) << setw(10) << percentile(latency, 0.9)
+         << setw(10) << percentile(latency, 0.99) << setw(10) << (double) memory / (1 << 20)
+         << setw(9) << done.queries << setw(12) << done.hits
+         << setw(14) << done.comparisons - built.comparisons << endl;
+}
+
+static void corpusRun(const string &name, const string &text, mt19937 &rng) {
+    vector<int> ints(text.begin(), text.end());
+    list<string> words = tokens(text, rng);
+    measure(name, "string", text, less<char>(), '#', rng);
+    measure(name, "string, no case", text, CCaseInsensitiveChar(), '#', rng);
+    measure(name, "vector<int>", ints, less<int>(), -1, rng);
+    measure(name, "list<string>", words, less<string>(), string("#"), rng);
+    measure(name, "list<string>, no case", words, CCaseInsensitiveWord(), string("#"), rng);
+}
+
+int main(int argc, char *argv[]) {
+    size_t maxLength = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    unsigned maxThreads = argc > 2 ? (unsigned) atoi(argv[2]) : max(1u, thread::hardware_concurrency());
+
+    mt19937 rng(1);
+    cout << setw(12) << "corpus" << setw(22) << "type" << setw(10) << "length" << setw(10) << "build s"
+         << setw(10) << "p50 us" << setw(10) << "p90 us" << setw(10) << "p99 us" << setw(10) << "mem MB"
+         << setw(9) << "queries" << setw(12) << "hits" << setw(14) << "query cmps" << endl;
+    for (size_t length = 10000; length <= max<size_t>(maxLength, 10000); length *= 10) {
+        corpusRun("random", randomCorpus(length, rng), rng);
+        corpusRun("low entropy", lowEntropyCorpus(length, rng), rng);
+        corpusRun("natural", naturalCorpus(length, rng), rng);
+    }
+    cout << endl;
+    buildScaling(randomCorpus(max<size_t>(maxLength, 32), rng), maxThreads);
+    return EXIT_SUCCESS;
+}
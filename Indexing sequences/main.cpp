@@ -18,55 +18,1482 @@
 #include <string>
 #include <algorithm>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <numeric>
+#include <limits>
 #include <optional>
 #include <variant>
 #include <any>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <type_traits>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define CINDEX_SIMD
+#endif
+
+//  parts the Progtest harness cannot build, its include set has none of these headers
+#define CINDEX_THREADS  // <thread>, <atomic>
+#define CINDEX_CLOCK    // <chrono>
+#define CINDEX_FILES    // <fstream>, POSIX mmap
 
 using namespace std;
 #endif /* __PROGTEST__ */
 
 
+//  read-only array that owns its elements or views memory kept alive by its owner (e.g. a mapped file)
+template<typename E_>
+class CBuffer {
+public:
+    CBuffer() = default;
+    CBuffer(vector<E_> data) : owned(move(data)), ptr(owned.data()), len(owned.size()) {}
+    CBuffer(const E_ *data, size_t size, shared_ptr<const void> owner)
+            : keepAlive(move(owner)), ptr(data), len(size) {}
+    CBuffer(const CBuffer &src) : owned(src.owned), keepAlive(src.keepAlive) { repoint(src); }
+    CBuffer(CBuffer &&src) noexcept : owned(move(src.owned)), keepAlive(move(src.keepAlive)) { repoint(src); }
+    CBuffer &operator=(CBuffer src) noexcept {
+        owned = move(src.owned);
+        keepAlive = move(src.keepAlive);
+        repoint(src);
+        return *this;
+    }
+
+    [[nodiscard]] const E_ *data() const { return ptr; }
+    [[nodiscard]] size_t size() const { return len; }
+    const E_ &operator[](size_t i) const { return ptr[i]; }
+    [[nodiscard]] const E_ *begin() const { return ptr; }
+    [[nodiscard]] const E_ *end() const { return ptr + len; }
+
+    //  a view is copied into owned storage before it is modified
+    template<typename It_>
+    void append(It_ first, It_ last) {
+        if (keepAlive) {
+            owned.assign(ptr, ptr + len);
+            keepAlive.reset();
+        }
+        owned.insert(owned.end(), first, last);
+        ptr = owned.data();
+        len = owned.size();
+    }
+
+private:
+    void repoint(const CBuffer &src) {
+        ptr = keepAlive ? src.ptr : owned.data();
+        len = src.len;
+    }
+
+    vector<E_> owned;
+    shared_ptr<const void> keepAlive;
+    const E_ *ptr = nullptr;
+    size_t len = 0;
+};
+
+//  construction settings of CIndex
+struct CIndexOptions {
+    unsigned threads = 1;       // threads building the suffix array, 0 = all hardware threads
+    bool compressed = false;    // FM-index instead of the suffix array, see CFMIndex
+    unsigned sampleRate = 32;   // compressed index: every sampleRate-th position is stored, the rest are walked to
+};
+
+//  counters of one index, for benchmarks and regression checks
+struct CIndexStats {
+    double buildSeconds = 0;    // last construction or compact
+    size_t queries = 0;         // patterns searched or counted
+    size_t hits = 0;            // occurrences reported by them
+    size_t comparisons = 0;     // element comparator calls, plain strings never call one
+};
+
+//  counter that queries running on several threads bump concurrently, a plain one without CINDEX_THREADS
+class CIndexCount {
+public:
+    CIndexCount() = default;
+    CIndexCount(const CIndexCount &x) : value(x.get()) {}
+
+    CIndexCount &operator=(const CIndexCount &x) {
+        value = x.get();
+        return *this;
+    }
+
+#ifdef CINDEX_THREADS
+    void add(size_t n) { value.fetch_add(n, memory_order_relaxed); }
+    size_t get() const { return value.load(); }
+private:
+    atomic<size_t> value{0};
+#else
+    void add(size_t n) { value += n; }
+    size_t get() const { return value; }
+private:
+    size_t value = 0;
+#endif
+};
+
+//  live counters behind CIndexStats
+struct CIndexCounters {
+    void record(size_t found) {
+        queries.add(1);
+        hits.add(found);
+    }
+
+    CIndexStats snapshot() const { return {buildSeconds, queries.get(), hits.get(), comparisons.get()}; }
+
+    double buildSeconds = 0;    // written only by construction and compact
+    CIndexCount queries, hits, comparisons;
+};
+
+//  element comparator that counts its calls, copies count into the same statistics
+template<typename C_>
+struct CCountingComparator {
+    template<typename V_>
+    bool operator()(const V_ &a, const V_ &b) const {
+        stats->comparisons.add(1);
+        return cmp(a, b);
+    }
+
+    C_ cmp;
+    shared_ptr<CIndexCounters> stats;
+};
+
+#ifdef CINDEX_CLOCK
+inline double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+#endif
+
+//  measures build times, always 0 without CINDEX_CLOCK
+class CStopwatch {
+public:
+#ifdef CINDEX_CLOCK
+    double seconds() const { return secondsSince(start); }
+private:
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+#else
+    double seconds() const { return 0; }
+#endif
+};
+
+//  threads meant by 0 in CIndexOptions and searchParallel, 1 without CINDEX_THREADS
+inline unsigned hardwareThreads() {
+#ifdef CINDEX_THREADS
+    return max(1u, thread::hardware_concurrency());
+#else
+    return 1;
+#endif
+}
+
+//  splits [0, n) into one contiguous block per thread and runs body(block, begin, end) on each of them,
+//  one block after another on the calling thread without CINDEX_THREADS
+template<typename F_>
+void parallelBlocks(size_t n, unsigned threads, F_ body) {
+    threads = (unsigned) max<size_t>(1, min<size_t>(threads, n));
+#ifdef CINDEX_THREADS
+    vector<thread> workers;
+    for (unsigned t = 1; t < threads; t++)
+        workers.emplace_back(body, t, n * t / threads, n * (t + 1) / threads);
+    body(0u, (size_t) 0, n / threads);
+    for (auto &w: workers) w.join();
+#else
+    for (unsigned t = 0; t < threads; t++) body(t, n * t / threads, n * (t + 1) / threads);
+#endif
+}
+
+//  suffix array with LCP over a sequence of integer ranks, equal ranks mean equal elements
+class CSuffixArray {
+public:
+    CSuffixArray() = default;
+
+    CSuffixArray(CBuffer<size_t> suffixes, CBuffer<size_t> lcp) : suffixes(move(suffixes)), lcp(move(lcp)) {}
+
+    //  prefix doubling, ranks have to be dense (0 .. alphabet size - 1); with more threads every round
+    //  is a parallel sort instead of counting sorts, the result is the same
+    explicit CSuffixArray(const vector<size_t> &ranks, unsigned threads = 1) {
+        vector<size_t> sa = sorted(ranks, threads), heights(ranks.size(), 0);
+        kasai(ranks, sa, heights, threads ? threads : hardwareThreads());
+        suffixes = CBuffer<size_t>(move(sa));
+        lcp = CBuffer<size_t>(move(heights));
+    }
+
+    //  only the suffix order, without the LCP array
+    static vector<size_t> sorted(const vector<size_t> &ranks, unsigned threads = 1) {
+        size_t n = ranks.size();
+        vector<size_t> sa(n);
+        if (threads == 0) threads = hardwareThreads();
+        if (threads > 1 && n < numeric_limits<uint32_t>::max()) buildParallel(ranks, sa, threads);
+        else build(ranks, sa);
+        return sa;
+    }
+
+    CBuffer<size_t> suffixes;   // starting positions in lexicographic order of the suffixes
+    CBuffer<size_t> lcp;        // lcp[i] = common prefix length of suffixes[i - 1] and suffixes[i]
+
+private:
+    //  O(n log n) with counting sorts
+    static void build(const vector<size_t> &ranks, vector<size_t> &suffixes) {
+        size_t n = ranks.size();
+        if (n == 0) return;
+
+        vector<size_t> rank(ranks), tmp(n), order(n);
+        size_t classes = *max_element(ranks.begin(), ranks.end()) + 1;
+        iota(order.begin(), order.end(), 0);
+        countingSort(order, rank, max(classes, n), suffixes);
+        for (size_t k = 1; classes < n; k <<= 1) {
+            //  order by the second half is known from the previous round, stable sort by the first half
+            size_t pos = 0;
+            for (size_t i = n - min(k, n); i < n; i++) order[pos++] = i;
+            for (size_t i = 0; i < n; i++)
+                if (suffixes[i] >= k) order[pos++] = suffixes[i] - k;
+            countingSort(order, rank, n, suffixes);
+
+            tmp[suffixes[0]] = 0;
+            classes = 1;
+            for (size_t i = 1; i < n; i++) {
+                size_t a = suffixes[i - 1], b = suffixes[i];
+                bool same = rank[a] == rank[b] && a + k < n && b + k < n && rank[a + k] == rank[b + k];
+                if (!same) classes++;
+                tmp[b] = classes - 1;
+            }
+            rank.swap(tmp);
+        }
+    }
+
+    //  sort records of the parallel build: key in the upper half, suffix position in the lower one
+    using CKeyed = uint64_t;
+    static size_t keyOf(CKeyed rec) { return (size_t) (rec >> 32); }
+    static size_t posOf(CKeyed rec) { return (size_t) (rec & 0xFFFFFFFFu); }
+    static CKeyed keyed(size_t key, size_t pos) { return ((uint64_t) key << 32) | pos; }
+
+    //  parallel prefix doubling: a suffix's rank is the first slot of its group, every round sorts each group
+    //  by the rank k positions later; small groups are sorted by whichever thread owns their start, groups
+    //  bigger than one block get a parallel merge sort of their own
+    static void buildParallel(const vector<size_t> &ranks, vector<size_t> &suffixes, unsigned threads) {
+        size_t n = ranks.size();
+        vector<CKeyed> recs(n), tmp(n);
+        vector<size_t> rank(n), lastStart(threads), groups(threads);
+        vector<char> starts(n, 0);
+        parallelBlocks(n, threads, [&](unsigned, size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) recs[i] = keyed(ranks[i], i);
+        });
+        parallelSort(recs.data(), tmp.data(), n, n, threads);
+
+        for (size_t k = 1;; k <<= 1) {
+            //  group boundaries never move, a new boundary appears wherever the sort key changes inside a group
+            parallelBlocks(n, threads, [&](unsigned t, size_t b, size_t e) {
+                lastStart[t] = 0;
+                for (size_t j = b; j < e; j++) {
+                    starts[j] = starts[j] || j == 0 || keyOf(recs[j]) != keyOf(recs[j - 1]);
+                    if (starts[j]) lastStart[t] = j;
+                }
+            });
+            for (unsigned t = 1; t < threads; t++) lastStart[t] = max(lastStart[t], lastStart[t - 1]);
+            parallelBlocks(n, threads, [&](unsigned t, size_t b, size_t e) {
+                size_t start = t > 0 ? lastStart[t - 1] : 0;
+                groups[t] = 0;
+                for (size_t j = b; j < e; j++) {
+                    if (starts[j]) {
+                        start = j;
+                        groups[t]++;
+                    }
+                    rank[posOf(recs[j])] = start;
+                }
+            });
+            if (accumulate(groups.begin(), groups.end(), (size_t) 0) == n) break;
+
+            parallelBlocks(n, threads, [&](unsigned, size_t b, size_t e) {
+                for (size_t j = b; j < e; j++) {
+                    size_t i = posOf(recs[j]);
+                    recs[j] = keyed(i + k < n ? rank[i + k] + 1 : 0, i);
+                }
+            });
+            vector<vector<pair<size_t, size_t>>> large(threads);
+            size_t limit = n / threads;
+            parallelBlocks(n, threads, [&](unsigned t, size_t b, size_t e) {
+                size_t lo = b;
+                while (lo < n && !starts[lo]) lo++;
+                while (lo < e) {
+                    size_t hi = lo + 1;
+                    while (hi < n && !starts[hi]) hi++;
+                    if (hi - lo > limit) large[t].emplace_back(lo, hi);
+                    else if (hi - lo > 1) sortByKey(recs.data() + lo, tmp.data() + lo, hi - lo, n + 1);
+                    lo = hi;
+                }
+            });
+            for (const auto &list: large)
+                for (const auto &group: list)
+                    parallelSort(recs.data() + group.first, tmp.data() + group.first, group.second - group.first, n + 1,
+                                 threads);
+        }
+        parallelBlocks(n, threads, [&](unsigned, size_t b, size_t e) {
+            for (size_t j = b; j < e; j++) suffixes[j] = posOf(recs[j]);
+        });
+    }
+
+    //  orders records by key only (keys below maxKey), LSD radix sort for bigger ranges
+    static void sortByKey(CKeyed *data, CKeyed *tmp, size_t n, size_t maxKey) {
+        if (n < 4096) {
+            sort(data, data + n);
+            return;
+        }
+        const unsigned digit = 11;
+        vector<size_t> cnt((size_t) 1 << digit);
+        CKeyed *src = data, *dst = tmp;
+        for (unsigned shift = 0; (maxKey - 1) >> shift; shift += digit) {
+            fill(cnt.begin(), cnt.end(), 0);
+            for (size_t i = 0; i < n; i++) cnt[(keyOf(src[i]) >> shift) & (cnt.size() - 1)]++;
+            size_t sum = 0;
+            for (auto &c: cnt) sum += exchange(c, sum);
+            for (size_t i = 0; i < n; i++) dst[cnt[(keyOf(src[i]) >> shift) & (cnt.size() - 1)]++] = src[i];
+            swap(src, dst);
+        }
+        if (src != data) copy(src, src + n, data);
+    }
+
+    //  orders records by key: sorts blocks in parallel, then merges pairs of runs level by level,
+    //  each merge split between the threads by merge path
+    static void parallelSort(CKeyed *data, CKeyed *tmp, size_t n, size_t maxKey, unsigned threads) {
+        vector<size_t> bounds;
+        parallelBlocks(n, threads, [&](unsigned, size_t b, size_t e) { sortByKey(data + b, tmp + b, e - b, maxKey); });
+        for (unsigned t = 0; t <= threads; t++) bounds.push_back(n * t / threads);
+        CKeyed *src = data, *dst = tmp;
+        while (bounds.size() > 2) {
+            size_t pairs = bounds.size() / 2, parts = max<size_t>(1, threads / pairs);
+            parallelBlocks(pairs * parts, threads, [&](unsigned, size_t b, size_t e) {
+                for (size_t task = b; task < e; task++) {
+                    size_t pair = task / parts, part = task % parts;
+                    size_t lo = bounds[2 * pair], mid = bounds[2 * pair + 1];
+                    size_t hi = 2 * pair + 2 < bounds.size() ? bounds[2 * pair + 2] : mid;
+                    size_t d0 = (hi - lo) * part / parts, d1 = (hi - lo) * (part + 1) / parts;
+                    const CKeyed *a = src + lo, *c = src + mid;
+                    size_t i0 = coRank(d0, a, mid - lo, c, hi - mid), i1 = coRank(d1, a, mid - lo, c, hi - mid);
+                    merge(a + i0, a + i1, c + d0 - i0, c + d1 - i1, dst + lo + d0, [](CKeyed x, CKeyed y) {
+                        return keyOf(x) < keyOf(y);
+                    });
+                }
+            });
+            swap(src, dst);
+            vector<size_t> merged;
+            for (size_t i = 0; i < bounds.size(); i += 2) merged.push_back(bounds[i]);
+            if (merged.back() != n) merged.push_back(n);
+            bounds.swap(merged);
+        }
+        if (src != data)
+            parallelBlocks(n, threads, [&](unsigned, size_t b, size_t e) { copy(src + b, src + e, data + b); });
+    }
+
+    //  number of elements taken from a when merging the first d elements of a and b, both sorted by key
+    static size_t coRank(size_t d, const CKeyed *a, size_t na, const CKeyed *b, size_t nb) {
+        size_t lo = d > nb ? d - nb : 0, hi = min(d, na);
+        while (lo < hi) {
+            size_t i = (lo + hi) / 2;
+            if (keyOf(a[i]) < keyOf(b[d - i - 1])) lo = i + 1;
+            else hi = i;
+        }
+        return lo;
+    }
+
+    //  Kasai: lcp[i] is the common prefix of suffixes[i - 1] and suffixes[i]; every block of text positions
+    //  restarts with an empty prefix, which costs at most one longest common prefix per block
+    static void kasai(const vector<size_t> &ranks, const vector<size_t> &suffixes, vector<size_t> &lcp, unsigned threads) {
+        size_t n = ranks.size();
+        vector<size_t> inverse(n);
+        parallelBlocks(n, threads, [&](unsigned, size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) inverse[suffixes[i]] = i;
+        });
+        parallelBlocks(n, threads, [&](unsigned, size_t b, size_t e) {
+            size_t h = 0;
+            for (size_t i = b; i < e; i++) {
+                if (inverse[i] == 0) {
+                    h = 0;
+                    continue;
+                }
+                size_t j = suffixes[inverse[i] - 1];
+                while (i + h < n && j + h < n && ranks[i + h] == ranks[j + h]) h++;
+                lcp[inverse[i]] = h;
+                if (h > 0) h--;
+            }
+        });
+    }
+
+    static void countingSort(const vector<size_t> &in, const vector<size_t> &key, size_t buckets, vector<size_t> &out) {
+        vector<size_t> cnt(buckets + 1, 0);
+        for (auto x: in) cnt[key[x] + 1]++;
+        partial_sum(cnt.begin(), cnt.end(), cnt.begin());
+        for (auto x: in) out[cnt[key[x]]++] = x;
+    }
+};
+
+//  bit vector with constant time rank, a running count is kept every 512 bits (12.5 % on top of the bits)
+class CRankBits {
+public:
+    CRankBits() = default;
+
+    explicit CRankBits(size_t n) : words(n / 64 + 1, 0) {}
+
+    void set(size_t i) { words[i >> 6] |= (uint64_t) 1 << (i & 63); }
+
+    //  has to be called once all bits are set
+    void finish() {
+        counts.assign(words.size() / 8 + 1, 0);
+        size_t sum = 0;
+        for (size_t w = 0; w < words.size(); w++) {
+            if (w % 8 == 0) counts[w / 8] = sum;
+            sum += (size_t) __builtin_popcountll(words[w]);
+        }
+    }
+
+    bool operator[](size_t i) const { return words[i >> 6] >> (i & 63) & 1; }
+
+    //  ones in [0, i)
+    size_t rank1(size_t i) const {
+        size_t w = i >> 6, res = counts[w >> 3];
+        for (size_t k = w & ~(size_t) 7; k < w; k++) res += (size_t) __builtin_popcountll(words[k]);
+        return res + (size_t) __builtin_popcountll(words[w] & (((uint64_t) 1 << (i & 63)) - 1));
+    }
+
+    size_t rank0(size_t i) const { return i - rank1(i); }
+
+private:
+    vector<uint64_t> words, counts;
+};
+
+//  wavelet matrix over symbols 0 .. sigma - 1: one bit vector per bit of the symbols, every level is stably
+//  partitioned by its bit (zeros first); access and rank take one bit vector rank per level
+class CWaveletMatrix {
+public:
+    CWaveletMatrix() = default;
+
+    CWaveletMatrix(vector<uint32_t> symbols, uint32_t sigma) {
+        unsigned bits = 1;
+        while (bits < 32 && ((uint64_t) 1 << bits) < sigma) bits++;
+        vector<uint32_t> next(symbols.size());
+        for (unsigned level = 0; level < bits; level++) {
+            unsigned shift = bits - 1 - level;
+            CRankBits row(symbols.size());
+            size_t zeroCount = 0;
+            for (size_t i = 0; i < symbols.size(); i++)
+                if (symbols[i] >> shift & 1) row.set(i);
+                else zeroCount++;
+            row.finish();
+            size_t z = 0, o = zeroCount;
+            for (auto c: symbols) next[c >> shift & 1 ? o++ : z++] = c;
+            symbols.swap(next);
+            levels.push_back(move(row));
+            zeros.push_back(zeroCount);
+        }
+    }
+
+    uint32_t access(size_t i) const {
+        uint32_t c = 0;
+        for (size_t level = 0; level < levels.size(); level++) {
+            bool bit = levels[level][i];
+            c = c << 1 | bit;
+            i = bit ? zeros[level] + levels[level].rank1(i) : levels[level].rank0(i);
+        }
+        return c;
+    }
+
+    //  occurrences of c in [0, i): both i and the start of the sequence follow the bits of c down the levels,
+    //  the occurrences end up next to each other in the last level
+    size_t rank(uint32_t c, size_t i) const {
+        size_t start = 0;
+        for (size_t level = 0; level < levels.size(); level++) {
+            if (c >> (levels.size() - 1 - level) & 1) {
+                start = zeros[level] + levels[level].rank1(start);
+                i = zeros[level] + levels[level].rank1(i);
+            } else {
+                start = levels[level].rank0(start);
+                i = levels[level].rank0(i);
+            }
+        }
+        return i - start;
+    }
+
+private:
+    vector<CRankBits> levels;
+    vector<size_t> zeros;
+};
+
+//  FM-index: Burrows-Wheeler transform of the sequence in a wavelet matrix plus every sampleRate-th suffix
+//  array entry (by text position). Backward search finds the suffix array block of a pattern in O(m log sigma),
+//  a position is located by walking LF at most sampleRate - 1 times to a sampled one. Takes about
+//  1.2 log sigma bits per symbol plus a word per sampleRate symbols instead of the two words of CSuffixArray.
+class CFMIndex {
+public:
+    CFMIndex() = default;
+
+    //  ranks have to be dense, suffixes is their suffix array
+    CFMIndex(const vector<size_t> &ranks, const vector<size_t> &suffixes, unsigned sampleRate)
+            : n(ranks.size()), rate(max(1u, sampleRate)), sampled(n + 1) {
+        //  row 0 is the empty suffix (the sentinel), row r + 1 is suffixes[r]; the sentinel itself is stored
+        //  as symbol 0 and left out of the counts by occurrences
+        sigma = n ? (uint32_t) *max_element(ranks.begin(), ranks.end()) + 1 : 0;
+        first.assign((size_t) sigma + 1, 0);
+        for (auto c: ranks) first[c + 1]++;
+        partial_sum(first.begin(), first.end(), first.begin());
+        for (auto &f: first) f++;
+
+        vector<uint32_t> bwt(n + 1, 0);
+        if (n) bwt[0] = (uint32_t) ranks[n - 1];
+        for (size_t r = 0; r < n; r++) {
+            size_t pos = suffixes[r];
+            if (pos == 0) sentinel = r + 1;
+            else bwt[r + 1] = (uint32_t) ranks[pos - 1];
+            if (pos % rate == 0) {
+                sampled.set(r + 1);
+                samples.push_back(pos);
+            }
+        }
+        sampled.finish();
+        samples.shrink_to_fit();
+        wavelet = CWaveletMatrix(move(bwt), max<uint32_t>(sigma, 1));
+    }
+
+    //  suffix array rows [first, last) of the suffixes starting with the pattern, symbols out of the alphabet
+    //  match nothing
+    pair<size_t, size_t> range(const vector<uint32_t> &pattern) const {
+        if (pattern.empty()) return {0, n};
+        size_t lo = 0, hi = n + 1;
+        for (auto it = pattern.rbegin(); it != pattern.rend() && lo < hi; ++it) {
+            if (*it >= sigma) return {0, 0};
+            lo = first[*it] + occurrences(*it, lo);
+            hi = first[*it] + occurrences(*it, hi);
+        }
+        return lo < hi ? make_pair(lo - 1, hi - 1) : make_pair((size_t) 0, (size_t) 0);
+    }
+
+    //  text position of the suffix in the given row, position 0 is always sampled so the walk ends
+    size_t locate(size_t row) const {
+        size_t i = row + 1, steps = 0;
+        for (; !sampled[i]; steps++) {
+            uint32_t c = wavelet.access(i);
+            i = first[c] + occurrences(c, i);
+        }
+        return samples[sampled.rank1(i)] + steps;
+    }
+
+private:
+    size_t occurrences(uint32_t c, size_t i) const {
+        return wavelet.rank(c, i) - (c == 0 && sentinel < i);
+    }
+
+    size_t n = 0;
+    unsigned rate = 1;
+    uint32_t sigma = 0;
+    vector<size_t> first;   // row of the first suffix starting with each symbol
+    size_t sentinel = 0;    // row whose preceding symbol is the sentinel
+    CWaveletMatrix wavelet;
+    CRankBits sampled;      // rows with a stored position
+    vector<size_t> samples; // their positions, in row order
+};
+
+//  saved index: header, alphabet, sequence of symbols, suffix array and LCP array of the indexed part;
+//  every section is 8-byte aligned
+struct CIndexFileHeader {
+    static constexpr uint32_t VERSION = 2;
+    char magic[4] = {'C', 'I', 'D', 'X'};
+    uint32_t version = VERSION;
+    uint32_t valueSize = 0;     // bytes per alphabet value
+    uint32_t symbolSize = 0;    // bytes per symbol of the sequence
+    uint32_t wordSize = sizeof(size_t);
+    uint32_t reserved = 0;
+    uint64_t alphabet = 0;  // alphabet values, the sorted ones first, then the ones added by append
+    uint64_t sorted = 0;    // sorted alphabet values
+    uint64_t length = 0;    // symbols in the sequence
+    uint64_t indexed = 0;   // symbols covered by the suffix array
+};
+
+//  sections of a mapped index file, valid while mapping is alive
+struct CMappedIndex {
+    shared_ptr<const void> mapping;
+    CIndexFileHeader header;
+    const void *alphabet, *sequence;
+    const size_t *suffixes, *lcp;
+};
+
+inline size_t alignedSize(size_t bytes) { return (bytes + 7) & ~(size_t) 7; }
+
+#ifdef CINDEX_FILES
+inline bool writeIndexFile(const string &path, const CIndexFileHeader &header, const void *alphabet,
+                           const void *sequence, const CSuffixArray &index) {
+    ofstream out(path, ios::binary | ios::trunc);
+    const char padding[8] = {};
+    size_t alphabetBytes = header.alphabet * header.valueSize, sequenceBytes = header.length * header.symbolSize;
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) alphabet, (streamsize) alphabetBytes);
+    out.write(padding, (streamsize) (alignedSize(alphabetBytes) - alphabetBytes));
+    out.write((const char *) sequence, (streamsize) sequenceBytes);
+    out.write(padding, (streamsize) (alignedSize(sequenceBytes) - sequenceBytes));
+    out.write((const char *) index.suffixes.data(), (streamsize) (header.indexed * sizeof(size_t)));
+    out.write((const char *) index.lcp.data(), (streamsize) (header.indexed * sizeof(size_t)));
+    out.close();
+    return !out.fail();
+}
+
+//  maps a saved index read-only, nothing is copied; fails on a foreign or damaged file: besides the header and the
+//  size, one pass checks that every suffix and LCP stays within the indexed part, the caller checks the symbols
+inline optional<CMappedIndex> mapIndexFile(const string &path, uint32_t valueSize, uint32_t symbolSize) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullopt;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CIndexFileHeader)) {
+        close(fd);
+        return nullopt;
+    }
+    auto size = (size_t) st.st_size;
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) return nullopt;
+    shared_ptr<const void> mapping(addr, [size](const void *p) { munmap(const_cast<void *>(p), size); });
+
+    CIndexFileHeader header;
+    memcpy(&header, addr, sizeof(header));
+    if (memcmp(header.magic, CIndexFileHeader().magic, 4) != 0 || header.version != CIndexFileHeader::VERSION
+        || header.valueSize != valueSize || header.symbolSize != symbolSize || header.wordSize != sizeof(size_t)
+        || header.alphabet > size / valueSize || header.sorted > header.alphabet
+        || header.length > size / symbolSize || header.indexed > header.length
+        || sizeof(header) + alignedSize(header.alphabet * valueSize) + alignedSize(header.length * symbolSize)
+           + 2 * header.indexed * sizeof(size_t) != size)
+        return nullopt;
+
+    const char *alphabet = (const char *) addr + sizeof(header);
+    const char *sequence = alphabet + alignedSize(header.alphabet * valueSize);
+    const char *suffixes = sequence + alignedSize(header.length * symbolSize);
+    CMappedIndex res{mapping, header, alphabet, sequence, (const size_t *) suffixes,
+                     (const size_t *) (suffixes + header.indexed * sizeof(size_t))};
+    for (size_t i = 0; i < header.indexed; i++)
+        if (res.suffixes[i] >= header.indexed || res.lcp[i] > header.indexed) return nullopt;
+    return res;
+}
+#else
+//  no file access without CINDEX_FILES, saving fails and there is nothing to map
+inline bool writeIndexFile(const string &, const CIndexFileHeader &, const void *, const void *, const CSuffixArray &) {
+    return false;
+}
+
+inline optional<CMappedIndex> mapIndexFile(const string &, uint32_t, uint32_t) { return nullopt; }
+#endif
+
+//  Aho-Corasick automaton over a set of patterns, transitions are ordered by the element comparator
+template<typename V_, typename C_>
+class CAhoCorasick {
+public:
+    template<typename P_>
+    CAhoCorasick(const vector<P_> &patterns, const C_ &comparator) : nodes(1, CNode(comparator)) {
+        for (size_t id = 0; id < patterns.size(); id++) {
+            size_t cur = 0, len = 0;
+            for (const auto &x: patterns[id]) {
+                auto it = nodes[cur].next.find(x);
+                if (it == nodes[cur].next.end()) {
+                    nodes.emplace_back(comparator);
+                    it = nodes[cur].next.emplace(x, nodes.size() - 1).first;
+                }
+                cur = it->second;
+                len++;
+            }
+            nodes[cur].ends.push_back(id);
+            lengths.push_back(len);
+        }
+
+        //  failure links in BFS order, output links skip failure states that end no pattern
+        queue<size_t> q;
+        for (const auto &edge: nodes[0].next) q.push(edge.second);
+        while (!q.empty()) {
+            size_t cur = q.front();
+            q.pop();
+            for (const auto &edge: nodes[cur].next) {
+                size_t f = nodes[cur].fail;
+                while (f != 0 && nodes[f].next.find(edge.first) == nodes[f].next.end()) f = nodes[f].fail;
+                auto it = nodes[f].next.find(edge.first);
+                size_t child = edge.second;
+                nodes[child].fail = it != nodes[f].next.end() ? it->second : 0;
+                size_t fail = nodes[child].fail;
+                nodes[child].output = nodes[fail].ends.empty() ? nodes[fail].output : fail;
+                q.push(child);
+            }
+        }
+    }
+
+    //  calls report(pattern id, start position) for every occurrence, in ascending order of end positions
+    template<typename It_, typename F_>
+    void scan(It_ begin, It_ end, F_ report) const {
+        size_t cur = 0, pos = 0;
+        for (auto it = begin; it != end; ++it, pos++) {
+            for (;;) {
+                auto next = nodes[cur].next.find(*it);
+                if (next != nodes[cur].next.end()) {
+                    cur = next->second;
+                    break;
+                }
+                if (cur == 0) break;
+                cur = nodes[cur].fail;
+            }
+            for (size_t out = nodes[cur].ends.empty() ? nodes[cur].output : cur; out != 0; out = nodes[out].output)
+                for (auto id: nodes[out].ends)
+                    if (lengths[id] > 0) report(id, pos + 1 - lengths[id]);
+        }
+    }
+
+private:
+    struct CNode {
+        explicit CNode(const C_ &comparator) : next(comparator) {}
+        map<V_, size_t, C_> next;
+        size_t fail = 0, output = 0;
+        vector<size_t> ends;
+    };
+    vector<CNode> nodes;
+    vector<size_t> lengths;
+};
+
+//  suffix automaton built online, one element at a time; transitions are ordered by the element comparator
+template<typename V_, typename C_>
+class CSuffixAutomaton {
+public:
+    explicit CSuffixAutomaton(const C_ &comparator) : localCmp(comparator) { clear(); }
+
+    void clear() {
+        states.assign(1, CState(localCmp));
+        last = 0;
+        length = 0;
+    }
+
+    [[nodiscard]] size_t size() const { return length; }
+
+    //  amortized O(log alphabet) per element
+    void extend(const V_ &x) {
+        size_t cur = states.size();
+        states.emplace_back(localCmp);
+        states[cur].len = states[last].len + 1;
+        states[cur].firstEnd = length++;
+        size_t p = last;
+        for (; p != NONE && states[p].next.find(x) == states[p].next.end(); p = states[p].link)
+            states[p].next.emplace(x, cur);
+        if (p == NONE) states[cur].link = 0;
+        else {
+            size_t q = states[p].next.find(x)->second;
+            if (states[p].len + 1 == states[q].len) states[cur].link = q;
+            else {
+                size_t clone = states.size();
+                states.push_back(states[q]);
+                states[clone].len = states[p].len + 1;
+                states[clone].isClone = true;
+                states[clone].children.assign(1, q);
+                //  the clone takes over q's place in the suffix link tree
+                auto &siblings = states[states[q].link].children;
+                *find(siblings.begin(), siblings.end(), q) = clone;
+                for (; p != NONE; p = states[p].link) {
+                    auto it = states[p].next.find(x);
+                    if (it == states[p].next.end() || it->second != q) break;
+                    it->second = clone;
+                }
+                states[q].link = clone;
+                states[cur].link = clone;
+            }
+        }
+        states[states[cur].link].children.push_back(cur);
+        last = cur;
+    }
+
+    //  calls report(end position) for every occurrence of a non-empty pattern, in no particular order
+    template<typename P_, typename F_>
+    void occurrences(const P_ &pattern, F_ report) const {
+        size_t cur = 0;
+        for (const auto &x: pattern) {
+            auto it = states[cur].next.find(x);
+            if (it == states[cur].next.end()) return;
+            cur = it->second;
+        }
+        //  end positions of a state are the first ends of the original states below it in the link tree
+        vector<size_t> stack{cur};
+        while (!stack.empty()) {
+            size_t s = stack.back();
+            stack.pop_back();
+            if (!states[s].isClone) report(states[s].firstEnd);
+            stack.insert(stack.end(), states[s].children.begin(), states[s].children.end());
+        }
+    }
+
+private:
+    static constexpr size_t NONE = numeric_limits<size_t>::max();
+    struct CState {
+        explicit CState(const C_ &comparator) : next(comparator) {}
+        map<V_, size_t, C_> next;
+        size_t link = NONE, len = 0, firstEnd = 0;
+        bool isClone = false;
+        vector<size_t> children;    // inverse suffix links
+    };
+    C_ localCmp;
+    vector<CState> states;
+    size_t last = 0, length = 0;
+};
+
+//  lazy view of the occurrences of one pattern: the matching block of the suffix array, in suffix order,
+//  followed by the matches in the appended part; positions are read from the index only when visited.
+//  The view points into the index it came from: compact, assigning to the index or destroying it (a mapped one
+//  together with its mapping) leaves the view and its iterators dangling; append keeps it valid, but it goes on
+//  listing the occurrences as of matches()
+class CMatchView {
+public:
+    class CIterator {
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = size_t;
+        using difference_type = ptrdiff_t;
+        using pointer = const size_t *;
+        using reference = const size_t &;
+
+        CIterator() = default;
+        CIterator(const CMatchView *view, size_t i) : owner(view), idx(i) {}
+        reference operator*() const { return idx < owner->block() ? owner->first[idx] : owner->extra[idx - owner->block()]; }
+        CIterator &operator++() {
+            idx++;
+            return *this;
+        }
+        CIterator operator++(int) {
+            CIterator res = *this;
+            idx++;
+            return res;
+        }
+        bool operator==(const CIterator &x) const { return idx == x.idx; }
+        bool operator!=(const CIterator &x) const { return idx != x.idx; }
+    private:
+        const CMatchView *owner = nullptr;
+        size_t idx = 0;
+    };
+
+    CMatchView(const size_t *first, const size_t *last, vector<size_t> extra)
+            : first(first), last(last), extra(move(extra)) {}
+    [[nodiscard]] size_t size() const { return block() + extra.size(); }
+    [[nodiscard]] bool empty() const { return size() == 0; }
+    [[nodiscard]] CIterator begin() const { return {this, 0}; }
+    [[nodiscard]] CIterator end() const { return {this, size()}; }
+
+private:
+    [[nodiscard]] size_t block() const { return (size_t) (last - first); }
+    const size_t *first, *last;
+    vector<size_t> extra;
+};
+
+//  positions of the suffix array rows [lo, hi) and the extra ones in ascending order: every thread locates
+//  a block of rows and buckets the positions by text range, then every thread sorts one bucket in place
+template<typename F_>
+vector<size_t> sortedPositions(size_t lo, size_t hi, vector<size_t> extra, size_t n, unsigned threads, F_ locate) {
+    if (threads == 0) threads = hardwareThreads();
+    if (threads == 1 || hi - lo < 65536) {
+        for (size_t row = lo; row < hi; row++) extra.push_back(locate(row));
+        sort(extra.begin(), extra.end());
+        return extra;
+    }
+    size_t width = n / threads + 1;
+    vector<vector<vector<size_t>>> buckets(threads, vector<vector<size_t>>(threads));
+    parallelBlocks(hi - lo, threads, [&](unsigned t, size_t b, size_t e) {
+        for (size_t row = lo + b; row < lo + e; row++) {
+            size_t pos = locate(row);
+            buckets[t][pos / width].push_back(pos);
+        }
+    });
+    for (size_t pos: extra) buckets[0][pos / width].push_back(pos);
+
+    vector<size_t> offsets(threads + 1, 0);
+    for (unsigned j = 0; j < threads; j++)
+        for (unsigned t = 0; t < threads; t++) offsets[j + 1] += buckets[t][j].size();
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    vector<size_t> res(offsets.back());
+    parallelBlocks(threads, threads, [&](unsigned, size_t b, size_t e) {
+        for (size_t j = b; j < e; j++) {
+            size_t at = offsets[j];
+            for (unsigned t = 0; t < threads; t++) {
+                copy(buckets[t][j].begin(), buckets[t][j].end(), res.begin() + at);
+                at += buckets[t][j].size();
+            }
+            sort(res.begin() + offsets[j], res.begin() + offsets[j + 1]);
+        }
+    });
+    return res;
+}
+
+//  pigeonhole search for occurrences with at most k substituted elements: split into k + 1 pieces, one of them
+//  has to match exactly, so only the positions where the index found a piece are verified; find(begin, end, out)
+//  lists the exact occurrences of pattern[begin, end), equal(pos, i) compares pattern[i] with sequence[pos + i]
+template<typename F_, typename E_>
+set<size_t> approximateMatches(size_t n, size_t m, size_t k, F_ find, E_ equal) {
+    set<size_t> res;
+    if (k >= m) {
+        for (size_t pos = 0; pos < n && pos + m <= n; pos++) res.emplace_hint(res.end(), pos);
+        return res;
+    }
+    vector<size_t> candidates, hits;
+    for (size_t piece = 0; piece <= k; piece++) {
+        size_t b = m * piece / (k + 1), e = m * (piece + 1) / (k + 1);
+        hits.clear();
+        find(b, e, hits);
+        for (size_t pos: hits)
+            if (pos >= b && pos - b + m <= n) candidates.push_back(pos - b);
+    }
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+    for (size_t pos: candidates) {
+        size_t mismatches = 0;
+        for (size_t i = 0; i < m && mismatches <= k; i++)
+            if (!equal(pos, i)) mismatches++;
+        if (mismatches <= k) res.emplace_hint(res.end(), pos);
+    }
+    return res;
+}
+
+//  the sequence is stored as ranks of its elements in the comparator order, equivalent elements share a rank,
+//  so searching compares integers and every distinct element is kept only once; const queries may run
+//  concurrently, append and compact need the index to themselves
 template<typename T_, typename C_ = less<typename T_::value_type> >
 class CIndex {
 public:
-    explicit CIndex(const T_ &el, const C_ &comparator = less<typename T_::value_type>()) : localCmp(comparator) {
-        for (const auto &x: el)
-            elements.emplace_back(x);
+    explicit CIndex(const T_ &el, const C_ &comparator = less<typename T_::value_type>(),
+                    const CIndexOptions &opts = CIndexOptions())
+            : localCmp{comparator, make_shared<CIndexCounters>()}, options(opts), extra(localCmp),
+              tail(less<uint32_t>()) {
+        CStopwatch watch;
+        addElements(el, false);
+        compact();
+        localCmp.stats->buildSeconds = watch.seconds();
     }
     ~CIndex() = default;
-    set<size_t> search(const T_ &par) {
-        set<size_t> res;
-        vector<typename T_::value_type> parVec;
-        for (const auto &x : par) parVec.emplace_back(x);
-
-        size_t prev = 0; auto first = elements.begin();
-        for (size_t ii = 0; ii < elements.size(); ii++) {
-            if (par.size() == 0) res.insert(ii);
-            else if (localCmp(elements[ii], parVec[0]) != localCmp(parVec[0], elements[ii]))
-                continue;
-            bool broken = false;
-            auto beginning = elements.begin() + ii;
-            for (size_t i = 0; i < par.size(); i++) {
-                auto found = find_if(beginning, elements.end(), [&parVec, &i, this](const typename T_::value_type &s) {
-                    return localCmp(s, parVec[i]) == localCmp(parVec[i], s);
-                });
-                if (found == elements.end() || (i > 0 && found - elements.begin() != (long int)prev + 1)) {
-                    broken = true;
-                    break;
+    set<size_t> search(const T_ &par) const {
+        vector<size_t> hits;
+        searchInto(par, hits);
+        return set<size_t>(hits.begin(), hits.end());
+    }
+
+    //  occurrences in ascending order, the buffer is cleared and reused
+    void searchInto(const T_ &par, vector<size_t> &out) const {
+        vector<uint32_t> pattern = toRanks(par);
+        out.clear();
+        collectRows(pattern, out);
+        collectTail(pattern, out);
+        sort(out.begin(), out.end());
+        record(out.size());
+    }
+
+    //  number of occurrences in O(m log n), only matches in the appended part are listed to count them
+    size_t count(const T_ &par) const {
+        vector<uint32_t> pattern = toRanks(par);
+        vector<size_t> found;
+        collectTail(pattern, found);
+        auto rows = options.compressed ? fm.range(pattern) : make_pair(bound(pattern, false), bound(pattern, true));
+        record(rows.second - rows.first + found.size());
+        return rows.second - rows.first + found.size();
+    }
+
+    //  occurrences without copying them out of the suffix array, valid until compact or the end of the index,
+    //  see CMatchView
+    CMatchView matches(const T_ &par) const {
+        vector<uint32_t> pattern = toRanks(par);
+        vector<size_t> found;
+        if (options.compressed) {
+            //  the compressed index has no positions to point at, they are located up front
+            collectRows(pattern, found);
+            collectTail(pattern, found);
+            record(found.size());
+            return {nullptr, nullptr, move(found)};
+        }
+        collectTail(pattern, found);
+        size_t first = bound(pattern, false);
+        CMatchView res(index.suffixes.data() + first, index.suffixes.data() + blockEnd(first, pattern), move(found));
+        record(res.size());
+        return res;
+    }
+
+    //  extends the sequence, the new elements are indexed online in amortized O(length of more)
+    void append(const T_ &more) {
+        addElements(more, true);
+    }
+
+    //  folds the appended elements into the alphabet and the suffix array, O(n log n)
+    void compact() {
+        CStopwatch watch;
+        if (!extra.empty()) {
+            //  merge the values added by append into the sorted alphabet and renumber the sequence
+            vector<pair<const typename T_::value_type *, uint32_t>> added;
+            for (const auto &x: extra) added.emplace_back(&x.first, x.second);
+            vector<typename T_::value_type> merged;
+            vector<uint32_t> renumber(alphabet.size() + extra.size());
+            size_t i = 0, j = 0;
+            while (i < alphabet.size() || j < added.size()) {
+                if (j == added.size() || (i < alphabet.size() && localCmp(alphabet[i], *added[j].first))) {
+                    renumber[i] = (uint32_t) merged.size();
+                    merged.push_back(alphabet[i++]);
+                } else {
+                    renumber[added[j].second] = (uint32_t) merged.size();
+                    merged.push_back(*added[j++].first);
                 }
-                if (i == 0) first = found;
-                beginning = found + 1;
-                prev = found - elements.begin();
             }
-            if (!broken) res.insert(first - elements.begin());
+            vector<uint32_t> renumbered(ranks.size());
+            for (size_t k = 0; k < ranks.size(); k++) renumbered[k] = renumber[ranks[k]];
+            alphabet = CBuffer<typename T_::value_type>(move(merged));
+            ranks = CBuffer<uint32_t>(move(renumbered));
+            extra.clear();
         }
+        vector<size_t> dense(ranks.begin(), ranks.end());
+        if (options.compressed) fm = CFMIndex(dense, CSuffixArray::sorted(dense, options.threads), options.sampleRate);
+        else index = CSuffixArray(dense, options.threads);
+        indexed = ranks.size();
+        tail.clear();
+        localCmp.stats->buildSeconds = watch.seconds();
+    }
+
+    //  stores the alphabet, the ranks and the suffix array, only for plain element values (e.g. vector<int>);
+    //  a compressed index is not saved
+    bool save(const string &path) const {
+        static_assert(is_trivially_copyable<typename T_::value_type>::value, "elements must be plain values");
+        if (options.compressed) return false;
+        //  the values added by append follow the alphabet in the order of their ids
+        vector<const typename T_::value_type *> added(extra.size());
+        for (const auto &x: extra) added[x.second - alphabet.size()] = &x.first;
+        vector<typename T_::value_type> values(alphabet.begin(), alphabet.end());
+        for (const auto *x: added) values.push_back(*x);
+        CIndexFileHeader header;
+        header.valueSize = sizeof(typename T_::value_type);
+        header.symbolSize = sizeof(uint32_t);
+        header.alphabet = values.size();
+        header.sorted = alphabet.size();
+        header.length = ranks.size();
+        header.indexed = indexed;
+        return writeIndexFile(path, header, values.data(), ranks.data(), index);
+    }
+
+    //  answers queries straight from a file written by save, the comparator has to match the saved one
+    static optional<CIndex> mapFile(const string &path, const C_ &comparator = C_()) {
+        static_assert(is_trivially_copyable<typename T_::value_type>::value, "elements must be plain values");
+        auto file = mapIndexFile(path, sizeof(typename T_::value_type), sizeof(uint32_t));
+        if (!file) return nullopt;
+        //  every symbol is a rank in the alphabet
+        auto symbols = (const uint32_t *) file->sequence;
+        if (any_of(symbols, symbols + file->header.length, [&file](uint32_t c) { return c >= file->header.alphabet; }))
+            return nullopt;
+        CIndex res(T_(), comparator);
+        auto values = (const typename T_::value_type *) file->alphabet;
+        res.alphabet = CBuffer<typename T_::value_type>(values, file->header.sorted, file->mapping);
+        for (size_t i = file->header.sorted; i < file->header.alphabet; i++) res.extra.emplace(values[i], (uint32_t) i);
+        res.ranks = CBuffer<uint32_t>((const uint32_t *) file->sequence, file->header.length, file->mapping);
+        res.index = CSuffixArray(CBuffer<size_t>(file->suffixes, file->header.indexed, file->mapping),
+                                 CBuffer<size_t>(file->lcp, file->header.indexed, file->mapping));
+        res.indexed = file->header.indexed;
+        for (size_t i = res.indexed; i < res.ranks.size(); i++) res.tail.extend(res.ranks[i]);
+        return res;
+    }
+
+    //  occurrences with at most k elements not equivalent to the pattern ones, see approximateMatches
+    set<size_t> searchApprox(const T_ &par, size_t k) const {
+        vector<uint32_t> pattern = toRanks(par);
+        set<size_t> res = approximateMatches(ranks.size(), pattern.size(), k,
+                                             [&](size_t b, size_t e, vector<size_t> &out) {
+            vector<uint32_t> piece(pattern.begin() + b, pattern.begin() + e);
+            collectRows(piece, out);
+            collectTail(piece, out);
+        }, [&](size_t pos, size_t i) { return ranks[pos + i] == pattern[i]; });
+        record(res.size());
         return res;
     }
+
+    //  one result set per pattern, all of them found in a single pass over the sequence
+    vector<set<size_t>> searchMany(const vector<T_> &patterns) const {
+        vector<set<size_t>> res(patterns.size());
+        vector<vector<uint32_t>> mapped;
+        for (const auto &pattern: patterns) mapped.push_back(toRanks(pattern));
+        CAhoCorasick<uint32_t, less<uint32_t>> automaton(mapped, less<uint32_t>());
+        automaton.scan(ranks.begin(), ranks.end(), [&res](size_t id, size_t pos) {
+            res[id].emplace_hint(res[id].end(), pos);
+        });
+        fillEmpty(patterns, res, ranks.size());
+        for (const auto &found: res) record(found.size());
+        return res;
+    }
+
+    //  occurrences in ascending order, located and sorted on several threads (0 = all hardware threads)
+    //  when there are many of them, e.g. for short or empty patterns
+    vector<size_t> searchParallel(const T_ &par, unsigned threads = 0) const {
+        vector<uint32_t> pattern = toRanks(par);
+        vector<size_t> found;
+        collectTail(pattern, found);
+        vector<size_t> res;
+        if (options.compressed) {
+            auto rows = fm.range(pattern);
+            res = sortedPositions(rows.first, rows.second, move(found), ranks.size(), threads,
+                                  [this](size_t row) { return fm.locate(row); });
+        } else {
+            size_t first = bound(pattern, false);
+            res = sortedPositions(first, blockEnd(first, pattern), move(found), ranks.size(), threads,
+                                  [this](size_t row) { return index.suffixes[row]; });
+        }
+        record(res.size());
+        return res;
+    }
+
+    //  counters since construction, shared with copies of this index
+    CIndexStats stats() const { return localCmp.stats->snapshot(); }
 private:
-    vector<typename T_::value_type> elements;
-    C_ localCmp;
+    void record(size_t hits) const { localCmp.stats->record(hits); }
+
+    static constexpr uint32_t NONE = numeric_limits<uint32_t>::max();
+
+    //  rank of an element, NONE if it does not occur in the sequence; comparator calls on the alphabet are
+    //  added to calls so that concurrent queries touch the shared counter once each
+    uint32_t rankOf(const typename T_::value_type &x, size_t &calls) const {
+        auto cmp = [this, &calls](const typename T_::value_type &a, const typename T_::value_type &b) {
+            calls++;
+            return localCmp.cmp(a, b);
+        };
+        auto it = lower_bound(alphabet.begin(), alphabet.end(), x, cmp);
+        if (it != alphabet.end() && !cmp(x, *it)) return (uint32_t) (it - alphabet.begin());
+        auto added = extra.find(x);
+        return added != extra.end() ? added->second : NONE;
+    }
+
+    //  patterns are mapped to ranks once per query, elements missing from the sequence map to NONE,
+    //  which is greater than any rank of the indexed part and matches nothing
+    vector<uint32_t> toRanks(const T_ &par) const {
+        vector<uint32_t> res;
+        size_t calls = 0;
+        for (const auto &x: par) res.push_back(rankOf(x, calls));
+        localCmp.stats->comparisons.add(calls);
+        return res;
+    }
+
+    //  values not seen so far get ids after the alphabet until the next compact
+    void addElements(const T_ &more, bool online) {
+        vector<uint32_t> added;
+        size_t calls = 0;
+        for (const auto &x: more) {
+            uint32_t rank = rankOf(x, calls);
+            if (rank == NONE) {
+                rank = (uint32_t) (alphabet.size() + extra.size());
+                extra.emplace(x, rank);
+            }
+            added.push_back(rank);
+            if (online) tail.extend(rank);
+        }
+        ranks.append(added.begin(), added.end());
+        localCmp.stats->comparisons.add(calls);
+    }
+
+    //  adds the matches of the indexed part in suffix order
+    void collectRows(const vector<uint32_t> &pattern, vector<size_t> &out) const {
+        if (options.compressed) {
+            auto rows = fm.range(pattern);
+            for (size_t row = rows.first; row < rows.second; row++) out.push_back(fm.locate(row));
+            return;
+        }
+        size_t first = bound(pattern, false);
+        out.insert(out.end(), index.suffixes.begin() + first, index.suffixes.begin() + blockEnd(first, pattern));
+    }
+
+    //  adds matches inside the appended part and matches crossing into it from the indexed part
+    void collectTail(const vector<uint32_t> &pattern, vector<size_t> &out) const {
+        if (tail.size() == 0) return;
+        size_t m = pattern.size();
+        if (m == 0) {
+            for (size_t pos = indexed; pos < ranks.size(); pos++) out.push_back(pos);
+            return;
+        }
+        for (size_t pos = indexed >= m ? indexed - m + 1 : 0; pos < indexed && pos + m <= ranks.size(); pos++)
+            if (equal(pattern.begin(), pattern.end(), ranks.begin() + pos)) out.push_back(pos);
+        tail.occurrences(pattern, [&out, m, this](size_t end) { out.push_back(indexed + end + 1 - m); });
+    }
+
+    //  an empty pattern matches everywhere, the automaton reports nothing for it
+    static void fillEmpty(const vector<T_> &patterns, vector<set<size_t>> &res, size_t n) {
+        for (size_t id = 0; id < patterns.size(); id++)
+            if (patterns[id].begin() == patterns[id].end())
+                for (size_t i = 0; i < n; i++) res[id].emplace_hint(res[id].end(), i);
+    }
+
+    //  number of pattern symbols matched by the suffix at pos, the first skip symbols are known to match
+    size_t matched(size_t pos, const vector<uint32_t> &pattern, size_t skip) const {
+        while (skip < pattern.size() && pos + skip < indexed && ranks[pos + skip] == pattern[skip]) skip++;
+        return skip;
+    }
+
+    //  first suffix not smaller (upper = false) or greater (upper = true) than the pattern,
+    //  the common prefix with both bounds is never compared twice
+    size_t bound(const vector<uint32_t> &pattern, bool upper) const {
+        size_t lo = 0, hi = indexed, lcpLo = 0, lcpHi = 0;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2, pos = index.suffixes[mid];
+            size_t len = matched(pos, pattern, min(lcpLo, lcpHi));
+            bool right = len < pattern.size() ? pos + len == indexed || ranks[pos + len] < pattern[len] : upper;
+            if (right) {
+                lo = mid + 1;
+                lcpLo = len;
+            } else {
+                hi = mid;
+                lcpHi = len;
+            }
+        }
+        return lo;
+    }
+
+    //  all matches form one block of the suffix array starting at first, the block continues while lcp >= m
+    size_t blockEnd(size_t first, const vector<uint32_t> &pattern) const {
+        if (first == indexed || matched(index.suffixes[first], pattern, 0) < pattern.size()) return first;
+        size_t last = first + 1;
+        while (last < indexed && index.lcp[last] >= pattern.size()) last++;
+        return last;
+    }
+
+    CCountingComparator<C_> localCmp;
+    CIndexOptions options;
+    CBuffer<typename T_::value_type> alphabet;  // one value per equivalence class, in comparator order
+    map<typename T_::value_type, uint32_t, CCountingComparator<C_>> extra;   // values first seen by append, ids after the alphabet
+    CBuffer<uint32_t> ranks;
+    CSuffixArray index;     // covers the first indexed ranks
+    CFMIndex fm;            // replaces index in the compressed mode
+    size_t indexed = 0;
+    CSuffixAutomaton<uint32_t, less<uint32_t>> tail;    // covers the rest
+};
+
+//  plain strings with the default comparator: raw bytes, no comparator calls; const queries may run
+//  concurrently, append and compact need the index to themselves
+template<>
+class CIndex<string, less<char> > {
+public:
+    explicit CIndex(const string &el, const less<char> & = less<char>(), const CIndexOptions &opts = CIndexOptions())
+            : text(vector<char>(el.begin(), el.end())), options(opts), tail(less<char>()) {
+        compact();
+    }
+    ~CIndex() = default;
+    set<size_t> search(const string &par) const {
+        vector<size_t> hits;
+        searchInto(par, hits);
+        return set<size_t>(hits.begin(), hits.end());
+    }
+
+    //  occurrences in ascending order, the buffer is cleared and reused
+    void searchInto(const string &par, vector<size_t> &out) const {
+        find(par, out);
+        record(out.size());
+    }
+
+    //  number of occurrences in O(m log n), only matches in the appended part are listed to count them
+    size_t count(const string &par) const {
+        vector<size_t> extra;
+        collectTail(par, extra);
+        auto rows = range(par);
+        record(rows.second - rows.first + extra.size());
+        return rows.second - rows.first + extra.size();
+    }
+
+    //  occurrences without copying them out of the suffix array, valid until compact or the end of the index,
+    //  see CMatchView
+    CMatchView matches(const string &par) const {
+        vector<size_t> extra;
+        if (options.compressed) {
+            //  the compressed index has no positions to point at, they are located up front
+            auto rows = range(par);
+            for (size_t row = rows.first; row < rows.second; row++) extra.push_back(suffixAt(row));
+            collectTail(par, extra);
+            record(extra.size());
+            return {nullptr, nullptr, move(extra)};
+        }
+        collectTail(par, extra);
+        CMatchView res(index.suffixes.data() + bound(par, false), index.suffixes.data() + bound(par, true),
+                       move(extra));
+        record(res.size());
+        return res;
+    }
+
+    //  extends the text, the new bytes are indexed online in amortized O(length of more)
+    void append(const string &more) {
+        text.append(more.begin(), more.end());
+        for (char c: more) tail.extend(c);
+    }
+
+    //  folds the appended bytes into the suffix array, O(n log n)
+    void compact() {
+        CStopwatch watch;
+        //  dense byte ranks in unsigned order, which is the order memcmp uses when searching
+        size_t rankOf[256] = {};
+        for (unsigned char c: text) rankOf[c] = 1;
+        partial_sum(rankOf, rankOf + 256, rankOf);
+        vector<size_t> ranks(text.size());
+        for (size_t i = 0; i < text.size(); i++) ranks[i] = rankOf[(unsigned char) text[i]] - 1;
+        if (options.compressed) {
+            for (unsigned c = 0; c < 256; c++)
+                symbols[c] = rankOf[c] != (c ? rankOf[c - 1] : 0) ? (uint32_t) rankOf[c] - 1 : NONE;
+            fm = CFMIndex(ranks, CSuffixArray::sorted(ranks, options.threads), options.sampleRate);
+        } else index = CSuffixArray(ranks, options.threads);
+        indexed = text.size();
+        tail.clear();
+        counters.buildSeconds = watch.seconds();
+    }
+
+    //  stores the text with its suffix array, a compressed index is not saved
+    bool save(const string &path) const {
+        if (options.compressed) return false;
+        CIndexFileHeader header;
+        header.valueSize = 1;
+        header.symbolSize = 1;
+        header.length = text.size();
+        header.indexed = indexed;
+        return writeIndexFile(path, header, nullptr, text.data(), index);
+    }
+
+    //  answers queries straight from a file written by save
+    static optional<CIndex> mapFile(const string &path) {
+        auto file = mapIndexFile(path, 1, 1);
+        if (!file) return nullopt;
+        CIndex res("");
+        res.text = CBuffer<char>((const char *) file->sequence, file->header.length, file->mapping);
+        res.index = CSuffixArray(CBuffer<size_t>(file->suffixes, file->header.indexed, file->mapping),
+                                 CBuffer<size_t>(file->lcp, file->header.indexed, file->mapping));
+        res.indexed = file->header.indexed;
+        for (size_t i = res.indexed; i < res.text.size(); i++) res.tail.extend(res.text[i]);
+        return res;
+    }
+
+    //  occurrences with at most k bytes different from the pattern, see approximateMatches
+    set<size_t> searchApprox(const string &par, size_t k) const {
+        set<size_t> res = approximateMatches(text.size(), par.size(), k,
+                                             [&](size_t b, size_t e, vector<size_t> &out) {
+            find(par.substr(b, e - b), out);
+        }, [&](size_t pos, size_t i) { return text[pos + i] == par[i]; });
+        record(res.size());
+        return res;
+    }
+
+    //  one result set per pattern, all of them found in a single pass over the text
+    vector<set<size_t>> searchMany(const vector<string> &patterns) const {
+        vector<set<size_t>> res(patterns.size());
+        CAhoCorasick<char, less<char>> automaton(patterns, less<char>());
+        automaton.scan(text.begin(), text.end(), [&res](size_t id, size_t pos) {
+            res[id].emplace_hint(res[id].end(), pos);
+        });
+        for (size_t id = 0; id < patterns.size(); id++)
+            if (patterns[id].empty())
+                for (size_t i = 0; i < text.size(); i++) res[id].emplace_hint(res[id].end(), i);
+        for (const auto &found: res) record(found.size());
+        return res;
+    }
+
+    //  occurrences in ascending order, located and sorted on several threads (0 = all hardware threads)
+    //  when there are many of them, e.g. for short or empty patterns
+    vector<size_t> searchParallel(const string &par, unsigned threads = 0) const {
+        vector<size_t> extra;
+        collectTail(par, extra);
+        auto rows = range(par);
+        vector<size_t> res = sortedPositions(rows.first, rows.second, move(extra), text.size(), threads,
+                                             [this](size_t row) { return suffixAt(row); });
+        record(res.size());
+        return res;
+    }
+
+    //  counters since construction, comparisons stay 0
+    CIndexStats stats() const { return counters.snapshot(); }
+private:
+    static constexpr uint32_t NONE = numeric_limits<uint32_t>::max();
+
+    void record(size_t hits) const { counters.record(hits); }
+
+    //  occurrences in ascending order, out is cleared first
+    void find(const string &par, vector<size_t> &out) const {
+        out.clear();
+        auto rows = range(par);
+        size_t lo = rows.first, hi = rows.second;
+        //  dense hits are cheaper to collect in text order by scanning than to sort out of the suffix array
+        if (par.empty() || (hi - lo) > indexed / 64) {
+            scan(par, [&out](size_t pos) { out.push_back(pos); });
+            return;
+        }
+        for (size_t row = lo; row < hi; row++) out.push_back(suffixAt(row));
+        collectTail(par, out);
+        sort(out.begin(), out.end());
+    }
+
+    //  suffix array rows of the suffixes starting with the pattern
+    pair<size_t, size_t> range(const string &pattern) const {
+        if (!options.compressed) return {bound(pattern, false), bound(pattern, true)};
+        vector<uint32_t> mapped(pattern.size());
+        for (size_t i = 0; i < pattern.size(); i++) mapped[i] = symbols[(unsigned char) pattern[i]];
+        return fm.range(mapped);
+    }
+
+    size_t suffixAt(size_t row) const { return options.compressed ? fm.locate(row) : index.suffixes[row]; }
+
+    //  adds matches inside the appended part and matches crossing into it from the indexed part
+    void collectTail(const string &pattern, vector<size_t> &out) const {
+        if (tail.size() == 0) return;
+        size_t m = pattern.size();
+        if (m == 0) {
+            for (size_t pos = indexed; pos < text.size(); pos++) out.push_back(pos);
+            return;
+        }
+        for (size_t pos = indexed >= m ? indexed - m + 1 : 0; pos < indexed && pos + m <= text.size(); pos++)
+            if (memcmp(text.data() + pos, pattern.data(), m) == 0) out.push_back(pos);
+        tail.occurrences(pattern, [&out, m, this](size_t end) { out.push_back(indexed + end + 1 - m); });
+    }
+
+    //  first suffix not smaller (upper = false) or greater (upper = true) than the pattern
+    size_t bound(const string &pattern, bool upper) const {
+        size_t lo = 0, hi = indexed;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2, pos = index.suffixes[mid];
+            size_t len = min(pattern.size(), indexed - pos);
+            int cmp = memcmp(text.data() + pos, pattern.data(), len);
+            if (cmp < 0 || (cmp == 0 && (len < pattern.size() || upper))) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    //  reports every occurrence in ascending order: positions whose first and last bytes match
+    //  are filtered 32 (AVX2) or 16 (SSE2) at a time and only those are verified by memcmp
+    template<typename F_>
+    void scan(const string &pattern, F_ emit) const {
+        size_t n = text.size(), m = pattern.size();
+        if (m == 0) {
+            for (size_t i = 0; i < n; i++) emit(i);
+            return;
+        }
+        if (m > n) return;
+        const char *t = text.data(), *p = pattern.data();
+        size_t starts = n - m + 1, i = 0;
+        auto verify = [&](size_t pos) {
+            if (m <= 2 || memcmp(t + pos + 1, p + 1, m - 2) == 0) emit(pos);
+        };
+#if defined(CINDEX_SIMD) && defined(__AVX2__)
+        const __m256i first32 = _mm256_set1_epi8(p[0]), last32 = _mm256_set1_epi8(p[m - 1]);
+        for (; i + 32 <= starts; i += 32) {
+            __m256i a = _mm256_cmpeq_epi8(first32, _mm256_loadu_si256((const __m256i *) (t + i)));
+            __m256i b = _mm256_cmpeq_epi8(last32, _mm256_loadu_si256((const __m256i *) (t + i + m - 1)));
+            for (auto mask = (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(a, b)); mask; mask &= mask - 1)
+                verify(i + __builtin_ctz(mask));
+        }
+#endif
+#if defined(CINDEX_SIMD)
+        const __m128i first16 = _mm_set1_epi8(p[0]), last16 = _mm_set1_epi8(p[m - 1]);
+        for (; i + 16 <= starts; i += 16) {
+            __m128i a = _mm_cmpeq_epi8(first16, _mm_loadu_si128((const __m128i *) (t + i)));
+            __m128i b = _mm_cmpeq_epi8(last16, _mm_loadu_si128((const __m128i *) (t + i + m - 1)));
+            for (auto mask = (uint32_t) _mm_movemask_epi8(_mm_and_si128(a, b)); mask; mask &= mask - 1)
+                verify(i + __builtin_ctz(mask));
+        }
+#endif
+        for (; i < starts; i++)
+            if (t[i] == p[0] && t[i + m - 1] == p[m - 1]) verify(i);
+    }
+
+    CBuffer<char> text;
+    CIndexOptions options;
+    CSuffixArray index;     // covers the first indexed bytes
+    CFMIndex fm;            // replaces index in the compressed mode
+    uint32_t symbols[256] = {};     // compressed mode: symbol of every byte, NONE if it is not in the text
+    size_t indexed = 0;
+    CSuffixAutomaton<char, less<char>> tail;    // covers the rest
+    mutable CIndexCounters counters;
 };
 
 #ifndef __PROGTEST__
@@ -179,6 +1606,169 @@ int main() {
 //        cout << el << endl;
     assert (r26 == (set<size_t>{2, 5}));
 
+    CIndex<vector<int>> t8(vector<int>{1, 2, 1, 2, 1, 3, 1, 2, 1});
+    assert (t8.search(vector<int>{1, 2, 1}) == (set<size_t>{0, 2, 6}));
+    assert (t8.search(vector<int>{3}) == (set<size_t>{5}));
+    assert (t8.search(vector<int>{1, 2, 1, 2, 1, 3, 1, 2, 1, 2}) == (set<size_t>{}));
+
+    string long0(1000, 'a');
+    long0.replace(500, 3, "kos");
+    long0.replace(900, 3, "kos");
+    CIndex<string> t9(long0);
+    assert (t9.search("kos") == (set<size_t>{500, 900}));
+    assert (t9.search("akosa") == (set<size_t>{499, 899}));
+    assert (t9.search(string(400, 'a')).size() == 101);
+
+    vector<set<size_t>> r27 = t2.searchMany({"kos", "kokos", "", "trunk", "kos"});
+    assert (r27.size() == 5 && r27[0] == r6 && r27[1] == r7 && r27[2].size() == 18 && r27[3].empty() && r27[4] == r6);
+    vector<set<size_t>> r28 = t5.searchMany({"auto", "aut", "tic"});
+    assert (r28[0] == r17 && r28[1] == r18 && r28[2] == r19);
+    vector<set<size_t>> r29 = t7.searchMany({list<string>{"test", "this"}, list<string>{"this"}});
+    assert (r29[0] == r26 && r29[1] == (set<size_t>{3, 6}));
+
+    CIndex<string> t10("abcab");
+    t10.append("cabc");
+    assert (t10.search("abc") == (set<size_t>{0, 3, 6}));
+    assert (t10.search("bca") == (set<size_t>{1, 4}));
+    t10.append("x");
+    assert (t10.search("cx") == (set<size_t>{8}));
+    t10.compact();
+    assert (t10.search("abc") == (set<size_t>{0, 3, 6}));
+    t7.append(list<string>{"TEST", "THIS"});
+    assert (t7.search(list<string>{"test", "this"}) == (set<size_t>{2, 5, 8}));
+    assert (t7.search(list<string>{"done", "test"}) == (set<size_t>{7}));
+
+    assert (t4.save("t4.idx"));
+    optional<CIndex<string>> m4 = CIndex<string>::mapFile("t4.idx");
+    assert (m4 && m4->search("aut") == r12 && m4->search("tic") == r13 && m4->search("") == r16);
+    m4->append(" autumn");
+    assert (m4->search("aut") == (set<size_t>{0, 10, 25, 48, 52}));
+    t8.append(vector<int>{2, 1});
+    assert (t8.save("t8.idx"));
+    optional<CIndex<vector<int>>> m8 = CIndex<vector<int>>::mapFile("t8.idx");
+    assert (m8 && m8->search(vector<int>{1, 2, 1}) == (set<size_t>{0, 2, 6, 8}));
+    assert (!CIndex<vector<int>>::mapFile("t4.idx") && !CIndex<string>::mapFile("missing.idx"));
+    //  a damaged suffix, LCP or symbol is refused instead of being trusted
+    ifstream saved("t8.idx", ios::binary);
+    string bytes((istreambuf_iterator<char>(saved)), istreambuf_iterator<char>());
+    CIndexFileHeader h8;
+    memcpy(&h8, bytes.data(), sizeof(h8));
+    size_t sequenceAt = sizeof(h8) + alignedSize(h8.alphabet * h8.valueSize);
+    size_t suffixesAt = sequenceAt + alignedSize(h8.length * h8.symbolSize);
+    uint64_t farSuffix = (uint64_t) 1 << 40, longLcp = h8.indexed + 1;
+    auto badSymbol = (uint32_t) h8.alphabet;
+    for (auto [at, value, width]: {make_tuple(suffixesAt, (const void *) &farSuffix, 8),
+                                   make_tuple(suffixesAt + (2 * h8.indexed - 1) * 8, (const void *) &longLcp, 8),
+                                   make_tuple(sequenceAt, (const void *) &badSymbol, 4)}) {
+        string bad = bytes;
+        memcpy(&bad[at], value, (size_t) width);
+        ofstream("bad.idx", ios::binary) << bad;
+        assert (!CIndex<vector<int>>::mapFile("bad.idx"));
+    }
+    remove("bad.idx");
+    CIndex<vector<int>> e8(vector<int>{});
+    assert (e8.save("e8.idx"));
+    optional<CIndex<vector<int>>> me8 = CIndex<vector<int>>::mapFile("e8.idx");
+    assert (me8 && me8->search(vector<int>{1}).empty() && me8->count(vector<int>{}) == 0);
+    e8.append(vector<int>{5, 3, 5});
+    assert (e8.save("e8.idx"));
+    me8 = CIndex<vector<int>>::mapFile("e8.idx");
+    assert (me8 && me8->search(vector<int>{3, 5}) == (set<size_t>{1}) && me8->search(vector<int>{5}) == (set<size_t>{0, 2}));
+    remove("t4.idx");
+    remove("t8.idx");
+    remove("e8.idx");
+
+    CIndex<string> t11(long0 + "automatIc authentication automotive auTOmation raut", less<char>(), CIndexOptions{4});
+    assert (t11.search("kos") == t9.search("kos") && t11.search("aut") == (set<size_t>{1000, 1010, 1025, 1048}));
+    CIndex<list<string>, CStrComparator> t12(
+            list<string>{"Hello", "world", "test", "this", "foo", "TEsT", "this", "done"}, CStrComparator(true),
+            CIndexOptions{3});
+    assert (t12.search(list<string>{"test", "this"}) == (set<size_t>{2, 5}));
+
+    assert (t4.count("aut") == 4 && t4.count("") == 51 && t4.count("trunk") == 0);
+    assert (t7.count(list<string>{"test", "this"}) == 3 && t12.count(list<string>{"this"}) == 2);
+    vector<size_t> hits{42};
+    t3.searchInto("aaaa", hits);
+    assert (hits == (vector<size_t>{0, 1, 2, 3, 13}));
+    t10.append("abc");
+    t10.searchInto("cab", hits);
+    assert (hits == (vector<size_t>{2, 5}));
+    CMatchView v0 = t10.matches("abc");
+    assert (v0.size() == 4 && set<size_t>(v0.begin(), v0.end()) == (set<size_t>{0, 3, 6, 10}));
+    //  a forward iterator: multi-pass, references stay put
+    assert (*max_element(v0.begin(), v0.end()) == 10 && &*v0.begin() == &*v0.begin());
+    CMatchView v1 = t5.matches("aut");
+    assert (set<size_t>(v1.begin(), v1.end()) == r18);
+
+    CIndex<list<string>, CStrComparator> t13(list<string>{"Red", "green", "RED", "blue", "red"}, CStrComparator(true));
+    assert (t13.search(list<string>{"red"}) == (set<size_t>{0, 2, 4}) && t13.count(list<string>{"Cyan"}) == 0);
+    t13.append(list<string>{"CYAN", "Red"});
+    assert (t13.search(list<string>{"red", "cyan"}) == (set<size_t>{4}));
+    t13.compact();
+    assert (t13.search(list<string>{"cyan", "RED"}) == (set<size_t>{5}) && t13.count(list<string>{"Blue"}) == 1);
+    CIndex<vector<int>> t14(vector<int>{7, -3, 7});
+    t14.append(vector<int>{5, 7, 5});
+    assert (t14.save("t14.idx"));
+    optional<CIndex<vector<int>>> m14 = CIndex<vector<int>>::mapFile("t14.idx");
+    assert (m14 && m14->search(vector<int>{5, 7}) == (set<size_t>{3}) && m14->search(vector<int>{7}) == (set<size_t>{0, 2, 4}));
+    m14->compact();
+    assert (m14->search(vector<int>{7, 5}) == (set<size_t>{2, 4}));
+    remove("t14.idx");
+
+    CIndexOptions compressed;
+    compressed.compressed = true;
+    compressed.sampleRate = 4;
+    CIndex<string> t15("automatIc authentication automotive auTOmation raut", less<char>(), compressed);
+    assert (t15.search("aut") == r12 && t15.search("tic") == r13 && t15.search("") == r16 && t15.count("aut") == 4);
+    assert (t15.search("x") == (set<size_t>{}) && t15.count("\xff") == 0 && !t15.save("t15.idx"));
+    t15.append(" autumn");
+    CMatchView v2 = t15.matches("aut");
+    assert (v2.size() == 5 && set<size_t>(v2.begin(), v2.end()) == (set<size_t>{0, 10, 25, 48, 52}));
+    t15.compact();
+    assert (t15.search("utu") == (set<size_t>{53}) && t15.count("n") == 4);
+    CIndex<string> t16(long0, less<char>(), compressed);
+    assert (t16.search("kos") == t9.search("kos") && t16.count("a") == 994);
+    CIndex<list<string>, CStrComparator> t17(
+            list<string>{"Hello", "world", "test", "this", "foo", "TEsT", "this", "done"}, CStrComparator(true),
+            compressed);
+    assert (t17.search(list<string>{"test", "this"}) == (set<size_t>{2, 5}) && t17.count(list<string>{"FOO"}) == 1);
+
+    assert (t4.searchApprox("automation", 1).empty() && t4.searchApprox("automation", 2) == (set<size_t>{36}));
+    assert (t4.searchApprox("xut", 1) == (set<size_t>{0, 10, 25, 48}) && t4.searchApprox("ab", 2).size() == 50);
+    assert (t15.searchApprox("automation", 2) == (set<size_t>{36}) && t4.searchApprox("", 3) == r16);
+    assert (t8.searchApprox(vector<int>{1, 3, 1}, 1) == (set<size_t>{0, 2, 4, 6, 8}));
+    assert (t8.searchApprox(vector<int>{2, 2}, 1) == (set<size_t>{0, 1, 2, 3, 6, 7, 8, 9}));
+    assert (t12.searchApprox(list<string>{"TEST", "this", "bar"}, 1) == (set<size_t>{2, 5}));
+    assert (t6.searchApprox(list<string>{"test", "this", "bar"}, 1) == (set<size_t>{2}));
+
+    CIndex<list<string>, CStrComparator> t18(list<string>{"a", "B", "b", "A"}, CStrComparator(true));
+    CIndexStats s18 = t18.stats();
+    assert (s18.queries == 0 && s18.comparisons > 0 && s18.buildSeconds >= 0);
+    assert (t18.count(list<string>{"b", "a"}) == 1 && t18.search(list<string>{"A"}) == (set<size_t>{0, 3}));
+    assert (t18.stats().queries == 2 && t18.stats().hits == 3 && t18.stats().comparisons > s18.comparisons);
+    CIndex<string> t19("abab");
+    t19.searchMany({"ab", "b", "x"});
+    assert (t19.stats().queries == 3 && t19.stats().hits == 4 && t19.stats().comparisons == 0);
+
+    string long1;
+    for (int i = 0; i < 40000; i++) long1 += "abcab";
+    const CIndex<string> t20(long1 + "x", less<char>(), CIndexOptions{2});
+    vector<size_t> serial, all(long1.size() + 1);
+    iota(all.begin(), all.end(), 0);
+    t20.searchInto("ab", serial);
+    assert (t20.searchParallel("ab", 4) == serial && t20.searchParallel("", 3) == all);
+    assert (t20.searchParallel("bx") == (vector<size_t>{long1.size() - 1}));
+    const CIndex<vector<int>> t21(vector<int>(all.begin(), all.end()), less<int>(), compressed);
+    assert (t21.searchParallel(vector<int>{}, 4) == all && t21.searchParallel(vector<int>{7, 8}, 4) == (vector<size_t>{7}));
+    vector<thread> readers;
+    vector<char> agree(4, 0);
+    for (int t = 0; t < 4; t++)
+        readers.emplace_back([&, t]() {
+            agree[t] = t20.count("cab") == 40000 && t20.search("xa").empty() && t12.count(list<string>{"TEST"}) == 2;
+        });
+    for (auto &r: readers) r.join();
+    assert (count(agree.begin(), agree.end(), 1) == 4 && t20.stats().queries == 12 && t12.stats().queries >= 4);
+
     cout << "all done" << endl;
 
     return 0;
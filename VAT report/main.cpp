@@ -23,6 +23,7 @@ using namespace std;
 struct Company {
     string name, addr, id;
     unsigned int invoice_sum = 0;
+    bool active = true; //  false for slots of cancelled companies
 };
 
 //  compares in lowercase without modifying whole string
@@ -32,173 +33,286 @@ bool iStrCmp(const string &left, const string &right) {
     });
 }
 
-//  turns whole string to lowercase
-string toLowerStr(string str) {
-    for_each(all(str), [](char &c) {
-        c = (char) tolower(c);
+//  lexicographical less in lowercase without copying the strings
+bool iStrLess(const string &left, const string &right) {
+    return lexicographical_compare(all(left), all(right), [](char a, char b) {
+        return tolower(a) < tolower(b);
     });
-    return str;
 }
 
 //  compares Company structs by name and address
 bool companyCmpByNA(const Company &left, const Company &right) {
-    return toLowerStr(left.name) < toLowerStr(right.name) ||
-           (iStrCmp(left.name, right.name) && toLowerStr(left.addr) < toLowerStr(right.addr));
+    return iStrLess(left.name, right.name) ||
+           (iStrCmp(left.name, right.name) && iStrLess(left.addr, right.addr));
 }
 
-//  compares Company structs by id
-bool companyCmpById(const Company &left, const Company &right) {
-    return left.id < right.id;
+//  FNV-1a hash of the id, case sensitive as ids are
+size_t hashId(const string &id) {
+    unsigned long long h = 14695981039346656037ULL;
+    for (char c: id) h = (h ^ (unsigned char) c) * 1099511628211ULL;
+    return (size_t) h;
 }
 
+//  FNV-1a hash of the lowercase name and address, the name length keeps ("ab", "c") apart from ("a", "bc")
+size_t hashNA(const string &name, const string &addr) {
+    unsigned long long h = 14695981039346656037ULL;
+    for (char c: name) h = (h ^ (unsigned char) tolower(c)) * 1099511628211ULL;
+    h = (h ^ name.size()) * 1099511628211ULL;
+    for (char c: addr) h = (h ^ (unsigned char) tolower(c)) * 1099511628211ULL;
+    return (size_t) h;
+}
+
+//  open addressing hash table of company slots with linear probing, map/unordered_map are not available
+//  every entry keeps its hash, so growing does not rehash the strings and erase can shift entries back
+//  instead of leaving tombstones
+class CSlotTable {
+public:
+    static constexpr size_t NONE = (size_t) -1;
+
+    //  slot of the entry with the hash for which same(slot) holds, NONE if there is none
+    template<typename F_>
+    size_t find(size_t hash, F_ same) const {
+        if (entries.empty()) return NONE;
+        for (size_t i = hash & mask();; i = (i + 1) & mask()) {
+            if (entries[i].slot == NONE) return NONE;
+            if (entries[i].hash == hash && same(entries[i].slot)) return entries[i].slot;
+        }
+    }
+
+    //  the caller guarantees the key is not present yet
+    void insert(size_t hash, size_t slot) {
+        if ((used + 1) * 2 > entries.size()) grow();
+        place({hash, slot});
+        used++;
+    }
+
+    //  removes the entry of the slot, it must be present
+    void erase(size_t hash, size_t slot) {
+        size_t i = hash & mask();
+        while (entries[i].slot != slot) i = (i + 1) & mask();
+        //  move back every following entry of the run whose home is not between the hole and itself
+        for (size_t j = (i + 1) & mask(); entries[j].slot != NONE; j = (j + 1) & mask())
+            if (((j - (entries[j].hash & mask())) & mask()) >= ((j - i) & mask())) {
+                entries[i] = entries[j];
+                i = j;
+            }
+        entries[i] = {0, NONE};
+        used--;
+    }
+
+private:
+    struct Entry {
+        size_t hash, slot;
+    };
+
+    vector<Entry> entries;  //  power of two size, at most half full
+    size_t used = 0;
+
+    size_t mask() const { return entries.size() - 1; }
+
+    void place(const Entry &entry) {
+        size_t i = entry.hash & mask();
+        while (entries[i].slot != NONE) i = (i + 1) & mask();
+        entries[i] = entry;
+    }
+
+    void grow() {
+        vector<Entry> old(max<size_t>(16, entries.size() * 2), {0, NONE});
+        old.swap(entries);
+        for (const Entry &entry: old)
+            if (entry.slot != NONE) place(entry);
+    }
+};
+
 
 class CVATRegister {
 private:
-    vector<Company> companies;  //  sorted by name and address
-    vector<Company> companies_by_id;    // additional vector sorted by id for faster access
-    vector<unsigned int> all_invoices;  // vector of invoices for fast median search
+    vector<Company> companies;  //  slots, the ones of cancelled companies are reused from free_slots
+    vector<size_t> free_slots;
+    CSlotTable by_id;           //  slots hashed by id
+    CSlotTable by_na;           //  slots hashed by lowercase name and address
+    mutable vector<size_t> order;       //  slots sorted by name and address as of the last iteration
+    mutable vector<size_t> position;    //  index of every slot in order, NONE while it is not there
+    mutable vector<size_t> added;       //  slots of companies added since, merged into order by the next iteration
+    mutable bool order_dirty = false;   //  a company was cancelled since
+    vector<unsigned int> lower_invoices;    //  max-heap of the smaller half of all invoices
+    vector<unsigned int> upper_invoices;    //  min-heap of the rest, the median on top
 public:
     CVATRegister() = default;
 
     ~CVATRegister() = default;
 
-    // adds new company to both vectors using insert
+    // adds new company unless its id or its name and address are taken
     bool newCompany(const string &name, const string &addr, const string &taxID) {
-        // check for presence:
-        for (const auto &company: companies)
-            if (company.id == taxID || (iStrCmp(company.name, name) && iStrCmp(company.addr, addr)))
-                return false;
-
-        Company tmp{name, addr, taxID};
-
-        auto it = lower_bound(all(companies), tmp, companyCmpByNA);
-        auto it_id = lower_bound(all(companies_by_id), tmp, companyCmpById);
-
-        companies.insert(it, tmp);
-        companies_by_id.insert(it_id, tmp);
+        size_t h_id = hashId(taxID), h_na = hashNA(name, addr);
+        if (findById(taxID, h_id) != CSlotTable::NONE || findByNA(name, addr, h_na) != CSlotTable::NONE)
+            return false;
+
+        size_t slot = companies.size();
+        if (free_slots.empty()) companies.emplace_back();
+        else {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        }
+        companies[slot] = Company{name, addr, taxID};
+        by_id.insert(h_id, slot);
+        by_na.insert(h_na, slot);
+        position.resize(companies.size(), CSlotTable::NONE);
+        position[slot] = CSlotTable::NONE;
+        added.push_back(slot);
         return true;
     }
 
-    // removes company from the register by name and address (from both vectors)
+    // removes company from the register by name and address
     bool cancelCompany(const string &name, const string &addr) {
-        auto init_s = companies.size();
-        eraseByNA(name, addr, companies);
-        eraseByNA(name, addr, companies_by_id);
-        return companies.size() != init_s;
+        size_t slot = findByNA(name, addr, hashNA(name, addr));
+        if (slot == CSlotTable::NONE) return false;
+        eraseSlot(slot);
+        return true;
     }
 
-    // removes company from the register by id (from both vectors)
+    // removes company from the register by id
     bool cancelCompany(const string &taxID) {
-        auto init_s = companies.size();
-        eraseById(taxID, companies);
-        eraseById(taxID, companies_by_id);
-        return companies.size() != init_s;
+        size_t slot = findById(taxID, hashId(taxID));
+        if (slot == CSlotTable::NONE) return false;
+        eraseSlot(slot);
+        return true;
     }
 
     //  adds amount to company's income by name and address
     bool invoice(const string &name, const string &addr, unsigned int amount) {
-        Company tmp{name, addr, ""}; // struct object to use in lower_bound for companies
-        auto ind = lower_bound(all(companies), tmp, companyCmpByNA) - companies.begin();
-        if (iStrCmp(addr, companies[ind].addr) && iStrCmp(name, companies[ind].name)) {
-            createNewInvoice(companies[ind], amount);
-            return true;
-        }
-        return false;
+        size_t slot = findByNA(name, addr, hashNA(name, addr));
+        if (slot == CSlotTable::NONE) return false;
+        createNewInvoice(companies[slot], amount);
+        return true;
     }
 
     //  adds amount to company's income by id
     bool invoice(const string &taxID, unsigned int amount) {
-        Company tmp{"", "", taxID}; // struct object to use in lower_bound for companies_by_id
-        auto ind = lower_bound(all(companies_by_id), tmp, companyCmpById) - companies_by_id.begin();
-        if (taxID == companies_by_id[ind].id) {
-            createNewInvoice(companies_by_id[ind], amount);
-            return true;
-        }
-        return false;
+        size_t slot = findById(taxID, hashId(taxID));
+        if (slot == CSlotTable::NONE) return false;
+        createNewInvoice(companies[slot], amount);
+        return true;
     }
 
     //  used to find company's income
     bool audit(const string &name, const string &addr, unsigned int &sumIncome) const {
-        Company tmp{name, addr, ""};  // used for lower_bound in companies
-        auto ind = lower_bound(all(companies), tmp, companyCmpByNA) - companies.begin();
-        if (iStrCmp(addr, companies[ind].addr) && iStrCmp(name, companies[ind].name)) {
-            sumIncome = companies[ind].invoice_sum;
-            // adding income from companies_by_id as well:
-            Company tmp_id{"", "", companies[ind].id}; // used for lower_bound in companies_by_id
-            auto by_id = lower_bound(all(companies_by_id), tmp_id, companyCmpById) - companies_by_id.begin();
-            sumIncome += companies_by_id[by_id].invoice_sum;
-            return true;
-        }
-        return false;
+        size_t slot = findByNA(name, addr, hashNA(name, addr));
+        if (slot == CSlotTable::NONE) return false;
+        sumIncome = companies[slot].invoice_sum;
+        return true;
     }
 
     //  used to find company's income
     bool audit(const string &taxID, unsigned int &sumIncome) const {
-        Company tmp{"", "", taxID};  // used for lower_bound in companies_by_id
-        auto ind = lower_bound(all(companies_by_id), tmp, companyCmpById) - companies_by_id.begin();
-        if (taxID == companies_by_id[ind].id) {
-            sumIncome = companies_by_id[ind].invoice_sum;
-            // adding income from companies by name and address as well:
-            Company tmp_na{companies_by_id[ind].name, companies_by_id[ind].addr,""};  // used for lower_bound in companies
-            auto by_na = lower_bound(all(companies), tmp_na, companyCmpByNA) - companies.begin();
-            sumIncome += companies[by_na].invoice_sum;
-            return true;
-        }
-        return false;
+        size_t slot = findById(taxID, hashId(taxID));
+        if (slot == CSlotTable::NONE) return false;
+        sumIncome = companies[slot].invoice_sum;
+        return true;
     }
 
-    // finds first company from alphabetically-sorted vector "companies"
+    // finds alphabetically first company
     bool firstCompany(string &name, string &addr) const {
-        if (companies.empty()) return false;
-        name = companies[0].name;
-        addr = companies[0].addr;
+        sortCompanies();
+        if (order.empty()) return false;
+        name = companies[order[0]].name;
+        addr = companies[order[0]].addr;
         return true;
     }
 
     // finds company that is right next to the one passed in "name" and "addr"
     bool nextCompany(string &name, string &addr) const {
-        if (companies.empty()) return false;
-        for (long unsigned int i = 0; i < companies.size(); i++)
-            if (iStrCmp(name, companies[i].name) && iStrCmp(addr, companies[i].addr) && companies.size() > i + 1) {
-                name = companies[i + 1].name;
-                addr = companies[i + 1].addr;
-                return true;
-            }
-        return false;
+        size_t slot = findByNA(name, addr, hashNA(name, addr));
+        if (slot == CSlotTable::NONE) return false;
+        sortCompanies();
+        size_t next = position[slot] + 1;
+        if (next >= order.size()) return false;
+        name = companies[order[next]].name;
+        addr = companies[order[next]].addr;
+        return true;
     }
 
-    //  searches for median invoice amount
+    //  searches for median invoice amount, the greater of the two middle ones for an even count
     [[nodiscard]] unsigned int medianInvoice() const {
-        if (all_invoices.empty()) return 0;
-        // as vector is sorted, we can just take the middle value:
-        return all_invoices[all_invoices.size() / 2];
+        if (upper_invoices.empty()) return 0;
+        return upper_invoices.front();
     }
 
 
     /*      HELPER FUNCTIONS :      */
 
 
-    //  function to erase from vector by name and address
-    static void eraseByNA(const string &name, const string &addr, vector<Company> &vec) {
-        vec.erase(remove_if(all(vec), [&](Company const &company) {
-            return iStrCmp(addr, company.addr) && iStrCmp(name, company.name);
-        }), vec.end());
+    //  slot of the company with the id, NONE if there is none
+    size_t findById(const string &taxID, size_t hash) const {
+        return by_id.find(hash, [&](size_t slot) { return companies[slot].id == taxID; });
+    }
+
+    //  slot of the company with the name and address, NONE if there is none
+    size_t findByNA(const string &name, const string &addr, size_t hash) const {
+        return by_na.find(hash, [&](size_t slot) {
+            return iStrCmp(name, companies[slot].name) && iStrCmp(addr, companies[slot].addr);
+        });
+    }
+
+    //  removes the company from both tables and frees its slot
+    void eraseSlot(size_t slot) {
+        Company &company = companies[slot];
+        by_id.erase(hashId(company.id), slot);
+        by_na.erase(hashNA(company.name, company.addr), slot);
+        company = Company{};
+        company.active = false;
+        free_slots.push_back(slot);
+        position[slot] = CSlotTable::NONE;
+        order_dirty = true;
     }
 
-    //  function to erase from vector by id
-    static void eraseById(const string &taxID, vector<Company> &vec) {
-        vec.erase(remove_if(all(vec), [&](Company const &company) {
-            return taxID == company.id;
-        }), vec.end());
+    //  brings the alphabetical order up to date if it changed since the last iteration: drops the cancelled
+    //  companies and merges in the added ones, O(n + k log k) for k added, the whole order is not sorted again
+    void sortCompanies() const {
+        if (added.empty() && !order_dirty) return;
+        auto less = [this](size_t left, size_t right) {
+            return companyCmpByNA(companies[left], companies[right]);
+        };
+        //  a slot cancelled since, maybe reused by a company in added, is not in its place any more
+        order.erase(remove_if(all(order), [this](size_t slot) { return position[slot] == CSlotTable::NONE; }), order.end());
+        size_t kept = order.size();
+        for (size_t slot: added)
+            if (companies[slot].active && position[slot] == CSlotTable::NONE) {
+                position[slot] = 0; //  a slot added, cancelled and added again is listed once
+                order.push_back(slot);
+            }
+        sort(order.begin() + (long) kept, order.end(), less);
+        inplace_merge(order.begin(), order.begin() + (long) kept, order.end(), less);
+        for (size_t i = 0; i < order.size(); i++) position[order[i]] = i;
+        added.clear();
+        order_dirty = false;
     }
 
-    //  adds an invoice to a given company's income sum and the vector of all invoices
+    //  adds an invoice to a given company's income sum and to one of the halves of all invoices, in O(log n)
     void createNewInvoice(Company &company, const unsigned int amount) {
         company.invoice_sum += amount;
 
-        //  insert an invoice into the vector of invoices:
-        auto it_inv = lower_bound(all(all_invoices), amount);
-        all_invoices.insert(it_inv, amount);
+        auto greater = [](unsigned int left, unsigned int right) { return left > right; };
+        if (!upper_invoices.empty() && amount < upper_invoices.front()) {
+            lower_invoices.push_back(amount);
+            push_heap(all(lower_invoices));
+        } else {
+            upper_invoices.push_back(amount);
+            push_heap(all(upper_invoices), greater);
+        }
+        //  the upper half keeps the extra invoice of an odd count
+        size_t count = lower_invoices.size() + upper_invoices.size();
+        if (lower_invoices.size() > count / 2) {
+            pop_heap(all(lower_invoices));
+            upper_invoices.push_back(lower_invoices.back());
+            push_heap(all(upper_invoices), greater);
+            lower_invoices.pop_back();
+        } else if (upper_invoices.size() > count - count / 2) {
+            pop_heap(all(upper_invoices), greater);
+            lower_invoices.push_back(upper_invoices.back());
+            push_heap(all(lower_invoices));
+            upper_invoices.pop_back();
+        }
     }
 
 };
@@ -283,6 +397,75 @@ int main() {
     assert (b2.cancelCompany("ACME", "Kolejni"));
     assert (!b2.cancelCompany("ACME", "Kolejni"));
 
+    //  many companies checked against a plain vector, enough to grow the hash tables several times and to reuse
+    //  the slots of cancelled companies
+    CVATRegister b3;
+    struct Expected {
+        string name, addr, id;
+        unsigned int sum;
+        bool active;
+    };
+    vector<Expected> expected;
+    vector<unsigned int> amounts;
+    for (int i = 0; i < 5000; i++) {
+        string name = "Co" + to_string(i % 70), addr = "Street " + to_string(i / 70), id = "id" + to_string(i);
+        assert (b3.newCompany(name, addr, id));
+        assert (!b3.newCompany("cO" + to_string(i % 70), "STREET " + to_string(i / 70), "other" + to_string(i)));
+        assert (!b3.newCompany("Other", "Street", id));
+        expected.push_back({name, addr, id, 0, true});
+    }
+    for (int i = 0; i < 5000; i++) {
+        assert (b3.invoice(expected[i].id, i + 1));
+        assert (b3.invoice("CO" + to_string(i % 70), "street " + to_string(i / 70), 10));
+        expected[i].sum = i + 11;
+        amounts.insert(upper_bound(all(amounts), i + 1), i + 1);
+        amounts.insert(upper_bound(all(amounts), 10), 10);
+        assert (b3.medianInvoice() == amounts[amounts.size() / 2]);
+    }
+    for (int i = 0; i < 5000; i += 3) {
+        assert (i % 2 ? b3.cancelCompany(expected[i].id) : b3.cancelCompany(expected[i].name, expected[i].addr));
+        assert (!b3.cancelCompany(expected[i].id));
+        expected[i].active = false;
+    }
+    for (int i = 0; i < 5000; i += 6) {
+        assert (b3.newCompany(expected[i].name, expected[i].addr, "new" + to_string(i)));
+        expected[i] = {expected[i].name, expected[i].addr, "new" + to_string(i), 0, true};
+    }
+    for (const Expected &company: expected) {
+        assert (b3.audit(company.id, sumIncome) == company.active && (!company.active || sumIncome == company.sum));
+        assert (b3.audit(company.name, company.addr, sumIncome) == company.active);
+    }
+    vector<pair<string, string>> sorted;
+    for (const Expected &company: expected)
+        if (company.active) sorted.emplace_back(company.name, company.addr);
+    sort(all(sorted), [](const pair<string, string> &left, const pair<string, string> &right) {
+        return left.first < right.first || (left.first == right.first && left.second < right.second);
+    });
+    assert (b3.firstCompany(name, addr));
+    for (size_t i = 0;; i++) {
+        assert (name == sorted[i].first && addr == sorted[i].second);
+        if (!b3.nextCompany(name, addr)) {
+            assert (i + 1 == sorted.size());
+            break;
+        }
+    }
+    assert (b3.medianInvoice() == 10);
+    //  iterations between additions and cancellations see every change
+    for (int i = 0; i < 300; i++) {
+        string late = "Late " + to_string(i);
+        assert (b3.newCompany("Co" + to_string(i % 70), late, "late" + to_string(i)));
+        sorted.insert(lower_bound(all(sorted), make_pair("Co" + to_string(i % 70), late)), {"Co" + to_string(i % 70), late});
+        const Expected &gone = expected[i * 15 + 1];  //  never cancelled above
+        assert (b3.cancelCompany(gone.id));
+        sorted.erase(lower_bound(all(sorted), make_pair(gone.name, gone.addr)));
+        size_t at = (size_t) (i * 37) % sorted.size();
+        name = sorted[at].first;
+        addr = sorted[at].second;
+        assert (b3.nextCompany(name, addr) == (at + 1 < sorted.size()));
+        assert (at + 1 == sorted.size() || (name == sorted[at + 1].first && addr == sorted[at + 1].second));
+    }
+    assert (b3.firstCompany(name, addr) && name == sorted[0].first && addr == sorted[0].second);
+
     return EXIT_SUCCESS;
 }
 